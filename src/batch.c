@@ -0,0 +1,477 @@
+// mode batch : remplit toute une liste de MNT (manifeste ou répertoire) en un
+// seul lancement, sans repayer MPI_Init ni la vérification de référence par
+// grille.
+//  - les grandes grilles (au moins o->large cases) sont remplies l'une après
+//    l'autre par tous les processus ensemble, comme dans main.c,
+//  - les autres sont distribuées dynamiquement : chaque processus prend la
+//    suivante dans une file commune (un compteur du processus 0, incrémenté
+//    par MPI_Fetch_and_op) et la remplit seul, avec ses threads OpenMP,
+//  - chaque petite grille est écrite par un thread pendant le calcul de la
+//    suivante.
+// Chaque sorte de grille a son contexte (libmnt.h), dont les tampons servent
+// d'une grille à la suivante.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <mpi.h>
+#include <omp.h>
+
+#include "check.h"
+#include "type.h"
+#include "io.h"
+#include "darboux.h"
+#include "darboux_multigrid.h"
+#include "decomp.h"
+#include "libmnt.h"
+#include "trace.h"
+#include "batch.h"
+
+// écriture d'un résultat par un thread, attendue avant la suivante
+typedef struct writer_t
+{
+    pthread_t thread;
+    bool busy;
+    mnt_format format;        // format written
+    mnt result;               // copy of the result being written
+    size_t size;              // capacity of result.terrain in bytes
+    char fname[PATH_MAX];
+}
+writer;
+
+static void *writer_main(void *arg)
+{
+    writer *w = arg;
+    FILE *f;
+
+    CHECK((f = fopen(w->fname, (w->format != MNT_ASCII) ? "wb" : "w"))
+          != NULL);
+    if (w->format == MNT_TILED)
+        mnt_write_tiled(&w->result, f);
+    else if (w->format == MNT_BINARY)
+        mnt_write_binary(&w->result, f);
+    else
+        mnt_write(&w->result, f);
+    CHECK(fclose(f) == 0);
+    return (NULL);
+}
+
+static void writer_wait(writer *w)
+{
+    if (!w->busy)
+        return;
+    CHECK(pthread_join(w->thread, NULL) == 0);
+    w->busy = false;
+}
+
+// écrit une copie de result, dont le tampon ne grandit qu'au besoin
+static void writer_start(writer *w, const mnt *result, const char *fname,
+                         const mnt_format format)
+{
+    const size_t size = (size_t) result->nrows * result->ncols * sizeof(float);
+    float *terrain = w->result.terrain;
+
+    writer_wait(w);
+    if (size > w->size)
+    {
+        free(terrain);
+        CHECK((terrain = malloc(size)) != NULL);
+        w->size = size;
+    }
+    memcpy(terrain, result->terrain, size);
+    w->result = *result;
+    w->result.terrain = terrain;
+    w->format = format;
+    CHECK(snprintf(w->fname, sizeof(w->fname), "%s", fname)
+          < (int) sizeof(w->fname));
+    CHECK(pthread_create(&w->thread, NULL, writer_main, w) == 0);
+    w->busy = true;
+}
+
+// ajoute la ligne s à la liste des noms (tampon extensible)
+static void append(char **buf, size_t *len, size_t *cap, const char *s)
+{
+    const size_t n = strlen(s);
+    if (*len + n + 2 > *cap)
+    {
+        *cap = 2 * (*len + n + 2);
+        CHECK((*buf = realloc(*buf, *cap)) != NULL);
+    }
+    memcpy(*buf + *len, s, n);
+    *len += n;
+    (*buf)[(*len)++] = '\n';
+    (*buf)[*len] = '\0';
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return (strcmp(*(char *const *) a, *(char *const *) b));
+}
+
+static bool has_suffix(const char *s, const char *suffix)
+{
+    const size_t n = strlen(s), k = strlen(suffix);
+    return (n > k && strcmp(s + n - k, suffix) == 0);
+}
+
+// noms des grilles, un par ligne : fichiers *.mnt, *.mntb et *.mntz du
+// répertoire input triés, ou lignes du manifeste input (sauf vides et
+// commentaires #)
+static char *list_names(char *input)
+{
+    char *buf = NULL, line[PATH_MAX];
+    size_t len = 0, cap = 0;
+    struct stat st;
+
+    append(&buf, &len, &cap, "");
+    len = 0;
+    buf[0] = '\0';
+    CHECK(stat(input, &st) == 0);
+    if (S_ISDIR(st.st_mode))
+    {
+        DIR *dir;
+        struct dirent *e;
+        char **names = NULL;
+        int n = 0, max = 0;
+
+        CHECK((dir = opendir(input)) != NULL);
+        while ((e = readdir(dir)) != NULL)
+        {
+            if (!has_suffix(e->d_name, ".mnt") &&
+                !has_suffix(e->d_name, ".mntb") &&
+                !has_suffix(e->d_name, ".mntz"))
+                continue;
+            if (n == max)
+            {
+                max = max ? 2 * max : 64;
+                CHECK((names = realloc(names, max * sizeof(char *))) != NULL);
+            }
+            CHECK((names[n++] = strdup(e->d_name)) != NULL);
+        }
+        CHECK(closedir(dir) == 0);
+        qsort(names, n, sizeof(char *), compare_names);
+        for (int k = 0; k < n; k++)
+        {
+            CHECK(snprintf(line, sizeof(line), "%s/%s", input, names[k])
+                  < (int) sizeof(line));
+            append(&buf, &len, &cap, line);
+            free(names[k]);
+        }
+        free(names);
+        return (buf);
+    }
+
+    FILE *f;
+    CHECK((f = fopen(input, "r")) != NULL);
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0' && line[0] != '#')
+            append(&buf, &len, &cap, line);
+    }
+    CHECK(fclose(f) == 0);
+    return (buf);
+}
+
+// vérification exacte du résultat d du bloc m de ctx, sans recalcul de
+// référence
+static bool verify(const options *o, const mnt_context *ctx, const mnt *m,
+                   const mnt *d)
+{
+    if (!o->verify)
+        return (true);
+    if (mnt_context_engine(ctx) == ENGINE_FIXED)
+        return (darboux_fixed_verify(m, &ctx->dc, d->terrain));
+    return (darboux_verify(m, &ctx->dc, d->terrain));
+}
+
+// format d'écriture des résultats
+static mnt_format output_format(const options *o)
+{
+    return (o->tiled ? MNT_TILED : o->binary ? MNT_BINARY : MNT_ASCII);
+}
+
+// nom du résultat de la grille in : même nom de fichier dans o->batch, avec
+// l'extension du format écrit à la place de la sienne
+static void output_name(const options *o, const char *in, char *out)
+{
+    const mnt_format format = output_format(o);
+    const char *ext = (format == MNT_TILED) ? ".mntz"
+                      : (format == MNT_BINARY) ? ".mntb" : ".mnt";
+    const char *base = strrchr(in, '/');
+    base = (base != NULL) ? base + 1 : in;
+    const char *dot = strrchr(base, '.');
+    const int n = (dot != NULL && dot != base) ? (int) (dot - base)
+                                               : (int) strlen(base);
+    CHECK(snprintf(out, PATH_MAX, "%s/%.*s%s", o->batch, n, base, ext)
+          < PATH_MAX);
+}
+
+// le répertoire de la grille in est-il o->batch : son résultat écraserait
+// une entrée, peut-être encore lue par un autre processus
+static bool in_output_dir(const options *o, const char *in)
+{
+    char dir[PATH_MAX], a[PATH_MAX], b[PATH_MAX];
+    const char *slash = strrchr(in, '/');
+    if (slash == NULL)
+        strcpy(dir, ".");
+    else
+        CHECK(snprintf(dir, sizeof(dir), "%.*s", (int) (slash - in + 1), in)
+              < (int) sizeof(dir));
+    CHECK(realpath(dir, a) != NULL);
+    CHECK(realpath(o->batch, b) != NULL);
+    return (strcmp(a, b) == 0);
+}
+
+// remplit la grille in avec tous les processus de ctx (blocs de son
+// découpage), comme main.c : lecture par blocs ou répartition depuis le
+// processus 0, écriture parallèle (par le processus 0 au format tuilé).
+// Renvoie la vérification.
+static bool fill_distributed(const options *o, mnt_context *ctx, char *in,
+                             char *out)
+{
+    const int format = mnt_detect(in);
+    mnt *h = mnt_read_header(in);
+
+    decomp *dc = mnt_context_decomp(ctx, h->nrows, h->ncols);
+    mnt m = *h;
+    m.nrows = dc->lnrows;
+    m.ncols = dc->lncols;
+    m.terrain = darboux_alloc(m.nrows, m.ncols);
+    if (format == MNT_BINARY)
+    {
+        decomp_read(dc, in, MNT_BINARY_HEADER, m.terrain);
+        mnt_from_little_endian(m.terrain, (size_t) m.ncols * m.nrows);
+    }
+    else if (format == MNT_TILED)
+        decomp_read_tiled(dc, in, m.terrain);
+    else
+    {
+        mnt *g = (ctx->rank == 0) ? mnt_read(in) : NULL;
+        decomp_scatter(dc, (g != NULL) ? g->terrain : NULL, m.terrain);
+        if (g != NULL)
+            mnt_free(g);
+    }
+
+    mnt d = {.terrain = NULL};
+    mnt_fill_block(ctx, &m, &d);
+    const bool ok = verify(o, ctx, &m, &d);
+
+    char header[MNT_TEXT_HEADER_MAX];
+    if (o->tiled)
+    {
+        mnt r = *h;
+        r.terrain = NULL;
+        if (ctx->rank == 0)
+            CHECK((r.terrain = malloc((size_t) r.nrows * r.ncols *
+                                      sizeof(float))) != NULL);
+        decomp_gather(dc, d.terrain, r.terrain);
+        if (ctx->rank == 0)
+        {
+            FILE *f;
+            CHECK((f = fopen(out, "wb")) != NULL);
+            mnt_write_tiled(&r, f);
+            CHECK(fclose(f) == 0);
+            free(r.terrain);
+        }
+    }
+    else if (o->binary)
+    {
+        mnt_binary_header(h, header);
+        decomp_write_binary(dc, out, header, d.terrain);
+    }
+    else
+        decomp_write_text(dc, out, header,
+                          mnt_text_header(h, header, sizeof(header)),
+                          d.terrain);
+
+    free(m.terrain);
+    free(h);
+    return (ok);
+}
+
+// remplit la grille in dans ce processus seul (contexte ctx sur
+// MPI_COMM_SELF), le résultat étant écrit par w
+static bool fill_local(const options *o, mnt_context *ctx, char *in,
+                       char *out, writer *w)
+{
+    const mnt_format format = mnt_detect(in);
+    mnt *g = (format == MNT_BINARY) ? mnt_read_binary(in)
+             : (format == MNT_TILED) ? mnt_read_tiled(in) : mnt_read(in);
+
+    mnt d = {.terrain = NULL};
+    mnt_fill(ctx, g, &d);
+    const bool ok = verify(o, ctx, g, &d);
+    writer_start(w, &d, out, output_format(o));
+
+    mnt_free(g);
+    return (ok);
+}
+
+void batch_run(const options *o)
+{
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // liste des grilles et leurs tailles, lues par le processus 0
+    char *names = NULL;
+    int len = 0, count = 0;
+    if (rank == 0)
+    {
+        names = list_names(o->input);
+        len = strlen(names) + 1;
+        if (mkdir(o->batch, 0777) != 0)
+            CHECK(errno == EEXIST);
+    }
+    MPI_Bcast(&len, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+        CHECK((names = malloc(len)) != NULL);
+    MPI_Bcast(names, len, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    for (char *p = names; *p != '\0'; p++)
+        count += (*p == '\n');
+    char **files;
+    long *cells;
+    CHECK((files = malloc((count + 1) * sizeof(char *))) != NULL);
+    CHECK((cells = malloc((count + 1) * sizeof(long))) != NULL);
+    char *p = names;
+    for (int k = 0; k < count; k++)
+    {
+        files[k] = p;
+        p = strchr(p, '\n');
+        *p++ = '\0';
+    }
+    if (rank == 0)
+    {
+        // deux grilles ne doivent pas avoir le même résultat (a.mnt et
+        // a.mntb)
+        char out[PATH_MAX], **outs;
+        CHECK((outs = malloc((count + 1) * sizeof(char *))) != NULL);
+        for (int k = 0; k < count; k++)
+        {
+            CHECK(!in_output_dir(o, files[k]));
+            output_name(o, files[k], out);
+            CHECK((outs[k] = strdup(out)) != NULL);
+            mnt *h = mnt_read_header(files[k]);
+            cells[k] = (long) h->nrows * h->ncols;
+            free(h);
+        }
+        qsort(outs, count, sizeof(char *), compare_names);
+        for (int k = 1; k < count; k++)
+            CHECK(strcmp(outs[k - 1], outs[k]) != 0);
+        for (int k = 0; k < count; k++)
+            free(outs[k]);
+        free(outs);
+    }
+    MPI_Bcast(cells, count, MPI_LONG, 0, MPI_COMM_WORLD);
+
+    int large = 0;
+    for (int k = 0; k < count; k++)
+        large += (cells[k] >= o->large);
+    if (rank == 0)
+        printf("Starting batch of %d grids (%d distributed) with %d "
+               "processes with %d threads.\n", count, large, size,
+               omp_get_max_threads());
+
+    // file des petites grilles : prochain indice, dans le processus 0
+    int *next;
+    MPI_Win win;
+    MPI_Win_allocate((rank == 0) ? sizeof(int) : 0, sizeof(int),
+                     MPI_INFO_NULL, MPI_COMM_WORLD, &next, &win);
+    if (rank == 0)
+    {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+        *next = 0;
+        MPI_Win_unlock(0, win);
+    }
+
+    // grilles, cases et résultats faux remplis par ce processus ; un
+    // contexte pour les grandes grilles, un autre pour ce processus seul
+    long stats[3] = {0, 0, 0};
+    char out[PATH_MAX];
+    writer w = {.busy = false, .size = 0, .result.terrain = NULL};
+    mnt_context all, self;
+    mnt_context_init(&all, MPI_COMM_WORLD);
+    mnt_context_init(&self, MPI_COMM_SELF);
+    mnt_context_options(&all, o);
+    mnt_context_options(&self, o);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double start = MPI_Wtime();
+
+    for (int k = 0; k < count; k++)
+    {
+        if (cells[k] < o->large)
+            continue;
+        const double t = trace_begin();
+        output_name(o, files[k], out);
+        const bool ok = fill_distributed(o, &all, files[k], out);
+        trace_end("large grid", t, k);
+        if (rank == 0)
+        {
+            stats[0]++;
+            stats[1] += cells[k];
+            stats[2] += !ok;
+        }
+    }
+
+    const int one = 1;
+    for (;;)
+    {
+        int k;
+        MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, win);
+        MPI_Fetch_and_op(&one, &k, MPI_INT, 0, 0, MPI_SUM, win);
+        MPI_Win_unlock(0, win);
+        // les grandes grilles sont sautées, déjà remplies
+        while (k < count && cells[k] >= o->large)
+        {
+            MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, win);
+            MPI_Fetch_and_op(&one, &k, MPI_INT, 0, 0, MPI_SUM, win);
+            MPI_Win_unlock(0, win);
+        }
+        if (k >= count)
+            break;
+
+        const double t = trace_begin();
+        output_name(o, files[k], out);
+        const bool ok = fill_local(o, &self, files[k], out, &w);
+        trace_end("grid", t, k);
+        stats[0]++;
+        stats[1] += cells[k];
+        stats[2] += !ok;
+    }
+    writer_wait(&w);
+    free(w.result.terrain);
+
+    MPI_Reduce((rank == 0) ? MPI_IN_PLACE : stats, stats, 3, MPI_LONG,
+               MPI_SUM, 0, MPI_COMM_WORLD);
+    const double time = MPI_Wtime() - start;
+
+    if (rank == 0)
+    {
+        printf("Batch time     : %3.5lf s\n", time);
+        printf("Grids          : %ld (%.1lf grids/s)\n", stats[0],
+               stats[0] / time);
+        printf("Cells          : %ld (%.3e cells/s)\n", stats[1],
+               stats[1] / time);
+        if (o->verify)
+        {
+            if (stats[2] == 0)
+                fprintf(stderr, "Ok results :)\n");
+            else
+                fprintf(stderr, "BAD RESULTS ! (%ld grids)\n", stats[2]);
+        }
+    }
+
+    mnt_context_free(&all);
+    mnt_context_free(&self);
+    MPI_Win_free(&win);
+    free(files);
+    free(cells);
+    free(names);
+}
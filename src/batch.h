@@ -0,0 +1,8 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include "options.h"
+
+void batch_run(const options *o);
+
+#endif
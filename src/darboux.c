@@ -2,11 +2,16 @@
 // (remplissage des cuvettes d'un MNT)
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
 #include <mpi.h>
+#include <omp.h>
 
 #include "check.h"
 #include "type.h"
+#include "io.h"
 #include "darboux.h"
+#include "trace.h"
 
 // si ce define n'est pas commenté, l'exécution affiche sur stderr la hauteur
 // courante en train d'être calculée (doit augmenter) et l'itération du calcul
@@ -17,6 +22,19 @@
 // pour accéder à un tableau de flotant linéarisé (ncols doit être défini) :
 #define WTERRAIN(w, i, j) (w[(i)*ncols+(j)])
 
+// largeur (en colonnes) d'une tuile de la liste des cases actives
+#define ACTIVE_TILE_COLS 64
+
+// pour accéder au drapeau de la tuile t de la ligne i (ntiles doit être défini)
+#define ACTIVE(a, i, t) (a[(i)*ntiles+(t)])
+
+// cases finales : un bit par case, un mot de 64 bits par tuile (ACTIVE_TILE_COLS
+// vaut 64), indexés comme ACTIVE. Une case est finale quand W y vaut le
+// terrain (no_data, bords, cases déjà redescendues au terrain) : W ne passe
+// jamais sous le terrain, elle ne changera plus et n'est plus relue.
+#define FINAL_BIT(j) ((uint64_t) 1 << ((j) % ACTIVE_TILE_COLS))
+#define FINAL_ALL (~(uint64_t) 0)
+
 // calcule la valeur max de hauteur sur un terrain
 float max_terrain(const mnt *restrict m)
 {
@@ -27,17 +45,40 @@ float max_terrain(const mnt *restrict m)
     return (max);
 }
 
-// initialise le tableau W de départ à partir d'un mnt m
-float *init_W(const mnt *restrict m)
+// copie W dans a, répartie entre les threads comme darboux_alloc() (first
+// touch)
+static float *copy_W(float *restrict a, const float *restrict W,
+                     const int nrows, const int ncols)
+{
+#pragma omp parallel for default(none) shared(a, W, nrows, ncols) schedule(static)
+    for (int i = 0; i < nrows; i++)
+        memcpy(&a[(size_t) i * ncols], &W[(size_t) i * ncols],
+               ncols * sizeof(float));
+    return (a);
+}
+
+// initialise le tableau W de départ (W[0] de ws, ou into s'il est donné) à
+// partir d'un mnt m, ou reprend l'estimation qui se trouve déjà dans W[0]
+// de ws si guess : un majorant du résultat, aux valeurs du terrain sur les
+// bords et les no_data (voir darboux_multigrid()). Le max est celui des
+// blocs de tous les processus de comm.
+static float *init_W(const mnt *restrict m, const bool guess,
+                     float *restrict into, workspace *ws, MPI_Comm comm)
 {
     int ncols = m->ncols, nrows = m->nrows;
-    float *restrict W;
-    CHECK((W = malloc(ncols * nrows * sizeof(float))) != NULL);
+    float *restrict W = (guess || into == NULL)
+                        ? workspace_grid(ws, WS_W0, nrows, ncols) : into;
+    if (guess)
+        return ((into != NULL) ? copy_W(into, W, nrows, ncols) : W);
 
     // initialisation W
     int j;
-    float max = max_terrain(m) + 10.f;
-#pragma omp parallel for default(none) private(j) shared(nrows, ncols, m, W, max)
+    float max = max_terrain(m);
+    // le max doit être celui de toute la grille, comme dans darboux_seq(),
+    // sinon les cases jamais atteintes diffèrent d'un processus à l'autre
+    MPI_Allreduce(MPI_IN_PLACE, &max, 1, MPI_FLOAT, MPI_MAX, comm);
+    max += 10.f;
+#pragma omp parallel for default(none) private(j) shared(nrows, ncols, m, W, max) schedule(static)
     for (int i = 0; i < nrows; i++)
     {
         for (j = 0; j < ncols; j++)
@@ -144,109 +185,1136 @@ int calcul_Wij(float *restrict W, const float *restrict Wprec, const mnt *m,
     return (modif);
 }
 
+// un voisin de valeur wv pour une case intérieure (voir calcul_row) : les
+// deux tests de calcul_Wij deviennent des sélections
+static inline float voisin_simd(const float w, const float wp, const float z,
+                                const float wv, const float no_data)
+{
+    // même temporaire float que dans calcul_Wij
+    const float Wn = wv + EPSILON;
+    const float w2 = (z >= Wn) ? z : ((wp > Wn) ? Wn : w);
+    return ((wv == no_data) ? w : w2);
+}
+
+// calcul_Wij sans branche sur les cases [j_first, j_last) de la ligne i, qui
+// doivent avoir leurs 8 voisins dans le tableau (1 <= i < nrows - 1,
+// 1 <= j_first, j_last < ncols). Les voisins sont pris dans l'ordre de
+// VOISINS, chacun remplaçant le résultat du précédent quand un test
+// réussit : le résultat est celui de calcul_Wij, au bit près. Les cases sans
+// descente (W <= Z, donc aussi no_data) gardent leur valeur. Renvoie le
+// nombre de cases modifiées.
+// Pas d'inlining : une fois dans la boucle des tuiles de compute_block, gcc
+// -O3 (-fsplit-loops) en fait aussi une copie non vectorisée, la plus appelée.
+__attribute__((noinline))
+static int calcul_row(float *restrict W, const float *restrict Wprec,
+                      const mnt *m, const int i, const int j_first,
+                      const int j_last)
+{
+    const int ncols = m->ncols;
+    const float no_data = m->no_data;
+    const float *restrict Z = &TERRAIN(m, i, 0);
+    const float *restrict up = &WTERRAIN(Wprec, i - 1, 0);
+    const float *restrict mid = &WTERRAIN(Wprec, i, 0);
+    const float *restrict down = &WTERRAIN(Wprec, i + 1, 0);
+    float *restrict out = &WTERRAIN(W, i, 0);
+    int modif = 0;
+
+#pragma omp simd reduction(+:modif)
+    for (int j = j_first; j < j_last; j++)
+    {
+        const float z = Z[j], wp = mid[j];
+        float w = wp;
+        w = voisin_simd(w, wp, z, up[j - 1], no_data);
+        w = voisin_simd(w, wp, z, up[j], no_data);
+        w = voisin_simd(w, wp, z, up[j + 1], no_data);
+        w = voisin_simd(w, wp, z, mid[j - 1], no_data);
+        w = voisin_simd(w, wp, z, mid[j + 1], no_data);
+        w = voisin_simd(w, wp, z, down[j - 1], no_data);
+        w = voisin_simd(w, wp, z, down[j], no_data);
+        w = voisin_simd(w, wp, z, down[j + 1], no_data);
+        w = (wp > z) ? w : wp;
+        out[j] = w;
+        // tout test réussi donne Z ou Wn, tous deux < Wprec[i,j]
+        modif += (w != wp);
+    }
+    return (modif);
+}
+
+// calcule les cases [j_first, j_last) de la ligne i : calcul_row sur
+// l'intérieur du tableau, calcul_Wij sur ses bords ; renvoie le nombre de
+// cases modifiées
+static int compute_row(float *restrict W, const float *restrict Wprec,
+                       const mnt *m, const int i, const int j_first,
+                       const int j_last)
+{
+    int modif = 0;
+#ifndef DARBOUX_PPRINT
+    if (i > 0 && i < m->nrows - 1)
+    {
+        const int j0 = j_first > 1 ? j_first : 1;
+        const int j1 = j_last < m->ncols - 1 ? j_last : m->ncols - 1;
+        if (j0 < j1)
+        {
+            for (int j = j_first; j < j0; j++)
+                modif += calcul_Wij(W, Wprec, m, i, j);
+            modif += calcul_row(W, Wprec, m, i, j0, j1);
+            for (int j = j1; j < j_last; j++)
+                modif += calcul_Wij(W, Wprec, m, i, j);
+            return (modif);
+        }
+    }
+#endif
+    // bords, ou suivi de la progression (calcul_Wij seulement)
+    for (int j = j_first; j < j_last; j++)
+        modif += calcul_Wij(W, Wprec, m, i, j);
+    return (modif);
+}
+
+// calcule les tuiles de la ligne i à recalculer à l'étape suivante : une
+// tuile est active si elle-même ou une de ses 8 tuiles voisines a été
+// modifiée, puisque calcul_Wij ne lit que les 8 voisins directs d'une case.
+static void row_active(unsigned char *restrict active,
+                       const unsigned char *restrict changed,
+                       const int nrows, const int ntiles, const int i)
+{
+    const int r0 = i > 0 ? i - 1 : 0;
+    const int r1 = i < nrows - 1 ? i + 1 : nrows - 1;
+    for (int t = 0; t < ntiles; t++)
+    {
+        const int t0 = t > 0 ? t - 1 : 0;
+        const int t1 = t < ntiles - 1 ? t + 1 : ntiles - 1;
+        unsigned char a = 0;
+        for (int r = r0; r <= r1; r++)
+            for (int c = t0; c <= t1; c++)
+                a |= ACTIVE(changed, r, c);
+        ACTIVE(active, i, t) = a;
+    }
+}
+
+// row_active sur les lignes [i_start, i_end)
+static void mark_active(unsigned char *restrict active,
+                        const unsigned char *restrict changed,
+                        const int nrows, const int ntiles,
+                        const int i_start, const int i_end)
+{
+#pragma omp parallel for default(none) shared(active, changed, nrows, ntiles, i_start, i_end) schedule(static)
+    for (int i = i_start; i < i_end; i++)
+        row_active(active, changed, nrows, ntiles, i);
+}
+
+// masque des cases finales de W (voir FINAL_BIT) dans final, les bits après
+// la dernière colonne étant mis à 1
+static uint64_t *final_mask(uint64_t *restrict final, const float *restrict W,
+                            const mnt *m, const int ntiles)
+{
+    const int nrows = m->nrows, ncols = m->ncols;
+#pragma omp parallel for default(none) shared(final, W, m, nrows, ncols, ntiles) schedule(static)
+    for (int i = 0; i < nrows; i++)
+    {
+        memset(&ACTIVE(final, i, 0), 0, ntiles * sizeof(uint64_t));
+        for (int j = 0; j < ntiles * ACTIVE_TILE_COLS; j++)
+            if (j >= ncols || !(WTERRAIN(W, i, j) > TERRAIN(m, i, j)))
+                ACTIVE(final, i, j / ACTIVE_TILE_COLS) |= FINAL_BIT(j);
+    }
+    return (final);
+}
+
+// bits des cases finales de W sur les colonnes [j_first, j_last) de la
+// ligne i, toutes dans la même tuile
+static inline uint64_t final_bits(const float *restrict W, const mnt *m,
+                                  const int i, const int j_first,
+                                  const int j_last)
+{
+    const int ncols = m->ncols;
+    const float *restrict w = &WTERRAIN(W, i, 0);
+    const float *restrict z = &TERRAIN(m, i, 0);
+    uint64_t bits = 0;
+#pragma omp simd reduction(|:bits)
+    for (int j = j_first; j < j_last; j++)
+        bits |= (uint64_t) !(w[j] > z[j]) << (j % ACTIVE_TILE_COLS);
+    return (bits);
+}
+
+// intervalle maximal entre deux tests de convergence en mode adaptatif
+#define CONVERGENCE_MAX_INTERVAL 64
+
+// détection de la convergence globale : avec interval == 1, un
+// MPI_Allreduce bloquant à chaque test ; sinon un MPI_Iallreduce lancé tous
+// les interval tests et attendu au suivant, pendant que le calcul continue.
+// Toutes les décisions sont prises au même test sur tous les processus, ils
+// s'arrêtent donc tous à la même itération.
+typedef struct convergence_t
+{
+    MPI_Comm comm;
+    int interval;   // tests entre deux réductions
+    bool adaptive;  // interval double à chaque réduction encore active
+    int countdown;  // tests restants avant la prochaine réduction
+    MPI_Request request;
+    bool send, recv; // tampons de la réduction en cours
+}
+convergence;
+
+static void convergence_init(convergence *c, MPI_Comm comm, const int interval)
+{
+    c->comm = comm;
+    c->adaptive = (interval == 0);
+    c->interval = c->adaptive ? 2 : interval;
+    c->countdown = c->interval;
+    c->request = MPI_REQUEST_NULL;
+}
+
+// à appeler à chaque fin d'itération pouvant servir de test, avec modif
+// local de cette itération ; renvoie false quand tous les processus ont
+// terminé. Une itération sans aucune modification sur aucun processus est un
+// point fixe : les itérations faites en attendant la réduction ne changent
+// plus rien et le résultat est identique.
+static bool convergence_check(convergence *c, const bool modif)
+{
+    if (c->interval == 1)
+    {
+        bool running;
+        MPI_Allreduce(&modif, &running, 1, MPI_C_BOOL, MPI_LOR, c->comm);
+        return (running);
+    }
+
+    if (--c->countdown > 0)
+        return (true);
+
+    if (c->request != MPI_REQUEST_NULL)
+    {
+        MPI_Wait(&c->request, MPI_STATUS_IGNORE);
+        if (!c->recv)
+            return (false);
+        if (c->adaptive && c->interval < CONVERGENCE_MAX_INTERVAL)
+            c->interval *= 2;
+    }
+
+    c->send = modif;
+    MPI_Iallreduce(&c->send, &c->recv, 1, MPI_C_BOOL, MPI_LOR, c->comm,
+                   &c->request);
+    c->countdown = c->interval;
+    return (true);
+}
+
+// marque actives les tuiles des lignes [i_start, i_end) qui recouvrent les
+// colonnes [j_start, j_end)
+static void force_active(unsigned char *restrict active, const int ntiles,
+                         const int i_start, const int i_end,
+                         const int j_start, const int j_end)
+{
+    if (j_end <= j_start)
+        return;
+    const int t0 = j_start / ACTIVE_TILE_COLS;
+    const int t1 = (j_end - 1) / ACTIVE_TILE_COLS;
+    for (int i = i_start; i < i_end; i++)
+        memset(&ACTIVE(active, i, t0), 1, t1 - t0 + 1);
+}
+
+// calcule le nouveau W fonction de l'ancien (Wprec) sur les tuiles actives
+// de la ligne i entre les colonnes [j_start, j_end) ; renvoie le nombre de
+// cases modifiées, toute modification étant cumulée dans le drapeau changed
+// de chaque tuile. Les tuiles dont toutes les cases sont finales sont sautées.
+// Une tuile calculée sans modification a les mêmes valeurs dans les deux
+// tableaux : ses cases au niveau du terrain y deviennent finales.
+static int compute_tiles(float *restrict W, const float *restrict Wprec,
+                          const mnt *m, const unsigned char *restrict active,
+                          unsigned char *restrict changed,
+                          uint64_t *restrict final, const int ntiles,
+                          const int i, const int j_start, const int j_end)
+{
+    int modif = 0;
+    const int t_start = j_start / ACTIVE_TILE_COLS;
+    const int t_end = (j_end - 1) / ACTIVE_TILE_COLS + 1;
+
+    for (int t = t_start; t < t_end; t++)
+    {
+        if (!ACTIVE(active, i, t) || ACTIVE(final, i, t) == FINAL_ALL)
+            continue;
+
+        const int j_first = t * ACTIVE_TILE_COLS > j_start ?
+                            t * ACTIVE_TILE_COLS : j_start;
+        const int j_last = (t + 1) * ACTIVE_TILE_COLS < j_end ?
+                           (t + 1) * ACTIVE_TILE_COLS : j_end;
+        // calcule les nouvelles valeurs de W[i,j] en utilisant les
+        // 8 voisins des positions [i,j] du tableau Wprec
+        const int tile_modif = compute_row(W, Wprec, m, i, j_first, j_last);
+        ACTIVE(changed, i, t) |= (tile_modif != 0);
+        if (tile_modif == 0)
+            ACTIVE(final, i, t) |= final_bits(W, m, i, j_first, j_last);
+        modif += tile_modif;
+    }
+    return (modif);
+}
+
+// compute_tiles sur le rectangle [i_start, i_end) x [j_start, j_end). Une
+// tuile peut être partagée entre plusieurs rectangles : son drapeau changed
+// est cumulé et doit être remis à zéro avant.
+static long compute_block(float *restrict W, const float *restrict Wprec,
+                          const mnt *m, const unsigned char *restrict active,
+                          unsigned char *restrict changed,
+                          uint64_t *restrict final, const int ntiles,
+                          const int i_start, const int i_end,
+                          const int j_start, const int j_end)
+{
+    long modif = 0;
+
+    if (i_end <= i_start || j_end <= j_start)
+        return (0);
+
+    // Clang-tidy: openmp-use-default-none
+    // Using default(none) clause forces developers to explicitly specify
+    // data sharing attributes for the variables referenced in the construct,
+    // thus making it obvious which variables are referenced, and what is
+    // their data sharing attribute, thus increasing readability and
+    // possibly making errors easier to spot.
+#pragma omp parallel for reduction(+:modif) default(none) shared(i_start, i_end, j_start, j_end, ntiles, active, changed, final, W, Wprec, m) schedule(static)
+    for (int i = i_start; i < i_end; i++)
+        modif += compute_tiles(W, Wprec, m, active, changed, final, ntiles,
+                               i, j_start, j_end);
+    return (modif);
+}
+
+// taille du cache L2 si le système ne la donne pas
+#define L2_CACHE_DEFAULT (1 << 20)
+
+// nombre d'itérations fusionnées par période sur un bloc sans case fantôme
+// (un seul processus) : rien n'y limite la fusion, sinon le test de
+// convergence qui n'a lieu qu'en fin de période
+#define FUSED_STEPS 8
+
+// lignes calculées à l'étape s d'une période : la zone perd une ligne
+// fantôme de chaque côté à chaque étape (voir darboux())
+static inline int row_start(const decomp *dc, const int s)
+{
+    return (dc->up ? 1 + s : 0);
+}
+
+static inline int row_end(const decomp *dc, const int nrows, const int s)
+{
+    return (dc->down ? nrows - 1 - s : nrows);
+}
+
+// nombre de bandes de lignes de la fusion d'itérations : une bande et ses
+// voisines tiennent dans le cache L2 (W, Wprec et le terrain), sans descendre
+// sous 2 * period lignes pour que les triangles de deux frontières ne se
+// touchent pas, ni sous une bande par thread.
+static int fused_bands(const int nrows, const int ncols, const int period)
+{
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 <= 0)
+        l2 = L2_CACHE_DEFAULT;
+
+    int rows = l2 / (3 * sizeof(float) * ncols) - 2 * period;
+    const int per_thread = (nrows + omp_get_max_threads() - 1)
+                           / omp_get_max_threads();
+    if (rows > per_thread)
+        rows = per_thread;
+    if (rows < 2 * period)
+        rows = 2 * period;
+
+    const int nbands = nrows / rows;
+    return (nbands > 1 ? nbands : 1);
+}
+
+// calcule la ligne i à l'étape s de la période (de in vers out) : ses tuiles
+// actives sont celles dont les voisines ont changé à l'étape précédente
+// (changed_in), ses modifications vont dans changed_out. À l'étape 0, les
+// cases fantômes viennent d'être reçues : elles et leurs voisines sont
+// recalculées. Renvoie le nombre de cases modifiées.
+static int step_row(float *restrict out, const float *restrict in,
+                     const mnt *m, const decomp *dc,
+                     unsigned char *restrict active,
+                     unsigned char *restrict changed_out,
+                     const unsigned char *restrict changed_in,
+                     uint64_t *restrict final, const int ntiles,
+                     const int s, const int i)
+{
+    const int nrows = m->nrows, ncols = m->ncols;
+    const int j_start = dc->left ? 1 + s : 0;
+    const int j_end = dc->right ? ncols - 1 - s : ncols;
+
+    row_active(active, changed_in, nrows, ntiles, i);
+    if (s == 0)
+    {
+        if ((i >= 1 && i < 1 + dc->up) ||
+            (i >= nrows - dc->down - 1 && i < nrows - 1 && dc->down))
+            force_active(active, ntiles, i, i + 1, 0, ncols);
+        force_active(active, ntiles, i, i + 1, 1, 1 + dc->left);
+        force_active(active, ntiles, i, i + 1, ncols - 1 - dc->right,
+                     ncols - 1);
+    }
+
+    memset(&ACTIVE(changed_out, i, 0), 0, ntiles);
+    if (j_end <= j_start)
+        return (0);
+    return (compute_tiles(out, in, m, active, changed_out, final, ntiles,
+                          i, j_start, j_end));
+}
+
+// itérations fusionnées : étapes [s0, period) de la période commençant à
+// l'état t0, rangé dans W[t0 % 2] (l'état t dans W[t % 2], ses tuiles
+// modifiées dans changed[t % 2]). Les lignes sont découpées en nbands bandes
+// qui restent dans le cache pendant plusieurs étapes (découpage en trapèzes
+// puis triangles) :
+//  - phase 1 : chaque bande avance seule, sa zone perdant une ligne de
+//    chaque côté intérieur à chaque étape (trapèze), car ses lignes de bord
+//    dépendent des bandes voisines,
+//  - phase 2 : autour de chaque frontière, le triangle manquant avance à son
+//    tour, avec les lignes des deux trapèzes voisins.
+// Deux lignes voisines n'ont jamais plus d'une étape d'écart : l'état qu'une
+// ligne lit chez sa voisine est toujours encore dans le bon tableau. Le
+// résultat est celui des étapes calculées une par une, au bit près.
+// Le nombre de cases modifiées à l'étape s est ajouté à modified[s].
+static void fused_steps(float *const W[2], unsigned char *const changed[2],
+                        unsigned char *restrict active,
+                        uint64_t *restrict final, const mnt *m,
+                        const decomp *dc, const int ntiles, const int nbands,
+                        const int t0, const int s0, const int period,
+                        long *modified)
+{
+    const int nrows = m->nrows;
+
+#pragma omp parallel default(none) shared(W, changed, active, final, m, dc, ntiles, nbands, t0, s0, period, nrows) reduction(+:modified[:period])
+    {
+#pragma omp for schedule(static)
+        for (int b = 0; b < nbands; b++)
+        {
+            const int r0 = b * nrows / nbands, r1 = (b + 1) * nrows / nbands;
+            for (int s = s0; s < period; s++)
+            {
+                const int t = t0 + s;
+                const int lo = (b == 0) ? row_start(dc, s) : r0 + s - s0;
+                const int hi = (b == nbands - 1) ? row_end(dc, nrows, s)
+                                                 : r1 - (s - s0);
+                for (int i = lo; i < hi; i++)
+                    modified[s] += step_row(W[(t + 1) % 2], W[t % 2], m, dc,
+                                            active, changed[(t + 1) % 2],
+                                            changed[t % 2], final, ntiles,
+                                            s, i);
+            }
+        }
+
+#pragma omp for schedule(static)
+        for (int b = 1; b < nbands; b++)
+        {
+            const int r = b * nrows / nbands;
+            for (int s = s0 + 1; s < period; s++)
+            {
+                const int t = t0 + s;
+                for (int i = r - (s - s0); i < r + (s - s0); i++)
+                    modified[s] += step_row(W[(t + 1) % 2], W[t % 2], m, dc,
+                                            active, changed[(t + 1) % 2],
+                                            changed[t % 2], final, ntiles,
+                                            s, i);
+            }
+        }
+    }
+}
+
+// alloue une grille de nrows x ncols flottants et l'initialise à 0 en
+// parallèle, lignes réparties entre les threads comme dans darboux()
+// (schedule static) : chaque page est placée par le système sur le nœud
+// NUMA du thread qui la calculera (first touch)
+float *darboux_alloc(const int nrows, const int ncols)
+{
+    float *restrict a;
+    CHECK((a = malloc((size_t) nrows * ncols * sizeof(float))) != NULL);
+#pragma omp parallel for default(none) shared(a, nrows, ncols) schedule(static)
+    for (int i = 0; i < nrows; i++)
+        memset(&a[(size_t) i * ncols], 0, ncols * sizeof(float));
+    return (a);
+}
+
+// redécoupe les bandes de lignes entre les processus (decomp_rebalance)
+// suivant le nombre de cases des tuiles modifiées par la dernière étape,
+// celle menant à l'état t : le terrain et W[t % 2] suivent leurs lignes, les
+// autres tableaux de ws sont refaits à la nouvelle taille et toutes les
+// tuiles redeviennent actives, comme au départ. Renvoie 1 si le découpage a
+// changé.
+static bool rebalance_rows(mnt *m, decomp *dc, float *W[2],
+                           unsigned char *changed[2],
+                           unsigned char *restrict *active,
+                           uint64_t *restrict *final,
+                           const int ntiles, const int t, workspace *ws)
+{
+    long *load;
+    CHECK((load = malloc(dc->nrows * sizeof(long))) != NULL);
+    // une ligne coûte au moins le parcours de ses drapeaux de tuiles
+    for (int i = 0; i < dc->nrows; i++)
+    {
+        long tiles = 0;
+        for (int k = 0; k < ntiles; k++)
+            tiles += ACTIVE(changed[t % 2], dc->up + i, k);
+        load[i] = ntiles + tiles * ACTIVE_TILE_COLS;
+    }
+
+    float *arrays[2] = {m->terrain, W[t % 2]};
+    const bool moved = decomp_rebalance(dc, load, arrays, 2);
+    free(load);
+    if (!moved)
+        return (0);
+
+    m->terrain = arrays[0];
+    W[t % 2] = arrays[1];
+    m->nrows = dc->lnrows;
+    const size_t flags = (size_t) m->nrows * ntiles;
+    // W[t % 2] a été réalloué à la taille exacte du nouveau bloc
+    workspace_set(ws, WS_W0 + t % 2, W[t % 2],
+                  (size_t) m->nrows * m->ncols * sizeof(float));
+    W[(t + 1) % 2] = copy_W(workspace_grid(ws, WS_W0 + (t + 1) % 2, m->nrows,
+                                           m->ncols),
+                            W[t % 2], m->nrows, m->ncols);
+    *final = final_mask(workspace_get(ws, WS_FINAL, flags * sizeof(uint64_t)),
+                        W[t % 2], m, ntiles);
+    for (int k = 0; k < 2; k++)
+    {
+        changed[k] = workspace_get(ws, WS_CHANGED0 + k, flags);
+        memset(changed[k], 1, flags);
+    }
+    *active = workspace_get(ws, WS_ACTIVE, flags);
+    return (1);
+}
+
 /*****************************************************************************/
 /*           Fonction de calcul principale - À PARALLÉLISER                  */
 /*****************************************************************************/
 // applique l'algorithme de Darboux sur le MNT m, pour calculer un nouveau MNT
-mnt *darboux(const mnt *restrict m)
+// Avec rebalance > 0, les bandes de lignes sont rééquilibrées entre les
+// processus toutes les rebalance périodes : m (terrain, nrows) et dc
+// décrivent alors le nouveau bloc local. guess : W de départ déjà dans ws,
+// sinon max + 10 (voir init_W()). Tous les tableaux viennent de ws, le
+// résultat rendu aussi, sauf W et Wprec d'un découpage partagé (dans
+// dc->shared, sans rééquilibrage).
+float *darboux(mnt *m, decomp *dc, const bool nonblocking, const int check,
+               const int rebalance, const bool guess, workspace *ws)
 {
     int ncols = m->ncols, nrows = m->nrows;
+    const int halo = dc->halo;
 
-    // initialisation
-    float *restrict W, *restrict Wprec;
-    CHECK((W = malloc(ncols * nrows * sizeof(float))) != NULL);
-    Wprec = init_W(m);
+    // initialisation : l'état t est dans W[t % 2], l'état initial dans W[0]
+    // et W[1], pour que les tuiles finales sautées soient justes dans les deux.
+    // En mémoire partagée (decomp_share()), les deux sont dans la fenêtre du
+    // nœud, où les voisins du nœud lisent directement leurs halos.
+    const bool shared = dc->node != MPI_COMM_NULL;
+    float *W[2];
+    W[0] = init_W(m, guess, shared ? dc->shared[0] : NULL, ws, dc->comm);
+    W[1] = copy_W(shared ? dc->shared[1]
+                         : workspace_grid(ws, WS_W1, nrows, ncols),
+                  W[0], nrows, ncols);
 
     // calcul : boucle principale
     bool modif = true, running = true;
-    int j;
-    // set start and end indexes for nrows loop
-    int j_start = size != 1 && rank != 0;
-    int j_end = nrows - (size != 1 && rank != size - 1);
+    // dc->up, dc->down, dc->left et dc->right cases fantômes sur chaque côté
+    // du bloc (aucune sur les bords de la grille)
+    int own_end = nrows - dc->down;
 
+    // liste des cases actives : seules les tuiles dont le voisinage a changé
+    // à l'étape précédente sont recalculées, les autres donneraient la
+    // même valeur. Une tuile sautée a la même valeur dans les deux tableaux
+    // (elle n'a pas changé à l'étape précédente), l'alternance des deux
+    // tableaux reste donc correcte. changed[t % 2] : tuiles modifiées par
+    // l'étape menant à l'état t, toutes pour l'état initial.
+    const int ntiles = (ncols + ACTIVE_TILE_COLS - 1) / ACTIVE_TILE_COLS;
+    const size_t flags = (size_t) nrows * ntiles;
+    unsigned char *restrict active = workspace_get(ws, WS_ACTIVE, flags);
+    unsigned char *changed[2] = {workspace_get(ws, WS_CHANGED0, flags),
+                                 workspace_get(ws, WS_CHANGED1, flags)};
+    memset(changed[0], 1, flags);
+    memset(changed[1], 1, flags);
+    uint64_t *restrict final = final_mask(
+        workspace_get(ws, WS_FINAL, flags * sizeof(uint64_t)), W[0], m,
+        ntiles);
+
+    // halos profonds : les cases fantômes ne sont échangées que toutes les
+    // halo itérations. Entre deux échanges, on recalcule aussi les cases
+    // fantômes dont les voisins sont encore connus : la zone calculée perd
+    // une ligne/colonne de chaque côté à chaque itération, et les cases
+    // possédées ont exactement les mêmes valeurs qu'avec un échange par
+    // itération. Une case fantôme recalculée change exactement quand la case
+    // d'origine change chez son propriétaire : elle peut donc compter dans
+    // modif sans fausser la terminaison.
+    // Les itérations d'une même période sont fusionnées par bandes de lignes
+    // (fused_steps) ; sans case fantôme, la période n'est limitée que par le
+    // test de convergence.
+    const bool alone = !dc->up && !dc->down && !dc->left && !dc->right;
+    const int period = (alone && halo < FUSED_STEPS) ? FUSED_STEPS : halo;
+    int nbands = fused_bands(nrows, ncols, period);
+
+    // cases modifiées à chaque étape de la période (cases fantômes
+    // recalculées comprises)
+    long *modified = workspace_get(ws, WS_STEPS, period * sizeof(long));
+
+    convergence conv;
+    convergence_init(&conv, dc->comm, check);
+    int step = 0;
     while (running)
     {
-        modif = 0; // sera mis à 1 s'il y a une modification
+        const int t0 = step;
+        int s0 = 0;
+        step += period;
+        memset(modified, 0, period * sizeof(long));
+        double t = trace_begin();
 
-        // 1 process = main process
-        if (size != 1)
+        if (nonblocking)
         {
+            // échange non bloquant : l'étape 0 est calculée à part.
+            // L'intérieur du bloc, qui ne lit aucune case fantôme, est
+            // calculé pendant les communications, le cadre autour seulement
+            // une fois les halos reçus
+            float *in = W[t0 % 2], *out = W[(t0 + 1) % 2];
+            unsigned char *ch = changed[(t0 + 1) % 2];
+            const int i_start = row_start(dc, 0), i_end = row_end(dc, nrows, 0);
+            const int j_start = dc->left ? 1 : 0;
+            const int j_end = dc->right ? ncols - 1 : ncols;
 
-            if (rank != size - 1)
-            {
-                // On envoie Wprec au processus suivant
-                MPI_Send(&Wprec[(nrows - 2) * ncols], ncols,
-                         MPI_FLOAT, rank + 1,
-                         0, MPI_COMM_WORLD);
-            }
+            MPI_Request requests[2 * DECOMP_NEIGHBOURS];
+            const int nreq = decomp_exchange_begin(dc, in, requests);
+            trace_end("exchange", t, t0);
+            t = trace_begin();
 
-            if (rank != 0)
-            {
-                // Attend de recevoir la ligne précédente du processus précédent
-                MPI_Recv(&Wprec[0], ncols,
-                         MPI_FLOAT, rank - 1, 0, MPI_COMM_WORLD,
-                         MPI_STATUS_IGNORE);
-
-                // Envoie la première ligne du processus actuel au processus précédent
-                MPI_Send(&Wprec[ncols], ncols,
-                         MPI_FLOAT, rank - 1,
-                         0, MPI_COMM_WORLD);
-            }
+            // les cases fantômes vont être reçues : elles et leurs
+            // voisines doivent être recalculées
+            mark_active(active, changed[t0 % 2], nrows, ntiles, i_start, i_end);
+            force_active(active, ntiles, 1, 1 + dc->up, 0, ncols);
+            force_active(active, ntiles, own_end - 1, nrows - 1, 0, ncols);
+            force_active(active, ntiles, 0, nrows, 1, 1 + dc->left);
+            force_active(active, ntiles, 0, nrows,
+                         ncols - 1 - dc->right, ncols - 1);
+            memset(&ACTIVE(ch, i_start, 0), 0, (i_end - i_start) * ntiles);
 
-            if (rank != size - 1)
-            {
-                // Attend de recevoir la première ligne du processus suivant
-                MPI_Recv(&Wprec[(nrows - 1) * ncols], ncols,
-                         MPI_FLOAT, rank + 1, 0, MPI_COMM_WORLD,
-                         MPI_STATUS_IGNORE);
-            }
+            const int ib = dc->up ? dc->up + 1 : i_start;
+            const int jb = dc->left ? dc->left + 1 : j_start;
+            int ie = dc->down ? own_end - 1 : i_end;
+            int je = dc->right ? ncols - dc->right - 1 : j_end;
+            if (ie < ib)
+                ie = ib;
+            if (je < jb)
+                je = jb;
 
+            modified[0] += compute_block(out, in, m, active, ch, final,
+                                         ntiles, ib, ie, jb, je);
+            trace_end("interior", t, t0);
+            t = trace_begin();
+            MPI_Waitall(nreq, requests, MPI_STATUSES_IGNORE);
+            trace_end("halo wait", t, t0);
+            t = trace_begin();
+            modified[0] += compute_block(out, in, m, active, ch, final,
+                                         ntiles, i_start, ib, j_start, j_end);
+            modified[0] += compute_block(out, in, m, active, ch, final,
+                                         ntiles, ie, i_end, j_start, j_end);
+            modified[0] += compute_block(out, in, m, active, ch, final,
+                                         ntiles, ib, ie, j_start, jb);
+            modified[0] += compute_block(out, in, m, active, ch, final,
+                                         ntiles, ib, ie, je, j_end);
+            trace_end("frame", t, t0);
+            s0 = 1;
+        } else
+        {
+            decomp_exchange(dc, W[t0 % 2]);
+            trace_end("exchange", t, t0);
         }
 
-        // Clang-tidy: openmp-use-default-none
-        // Using default(none) clause forces developers to explicitly specify
-        // data sharing attributes for the variables referenced in the construct,
-        // thus making it obvious which variables are referenced, and what is
-        // their data sharing attribute, thus increasing readability and
-        // possibly making errors easier to spot.
-#pragma omp parallel for reduction(|:modif) default(none) private(j) shared(nrows,rank, j_start, j_end, ncols, W, Wprec, m)
-        // calcule le nouveau W fonction de l'ancien (Wprec) en chaque point [i,j]
-        for (int i = j_start; i < j_end; i++)
+        if (s0 < period)
         {
-            for (j = 0; j < ncols; j++)
-            {
-                // calcule la nouvelle valeur de W[i,j]
-                // en utilisant les 8 voisins de la position [i,j] du tableau Wprec
-               modif |= calcul_Wij(W, Wprec, m, i, j);
-            }
+            t = trace_begin();
+            fused_steps(W, changed, active, final, m, dc, ntiles, nbands,
+                        t0, s0, period, modified);
+            trace_end("compute", t, t0);
         }
+        // une étape par compteur, réparties sur la période
+        if (trace_enabled)
+        {
+            const double t_end = trace_begin();
+            for (int s = 0; s < period; s++)
+                trace_count("modified", t + (t_end - t) * s / period,
+                            modified[s]);
+        }
+        // seule compte la dernière étape de la période
+        modif = modified[period - 1] != 0;
 
 #ifdef DARBOUX_PPRINT
         dpprint();
 #endif
 
-        // échange W et Wprec
-        // sans faire de copie mémoire : échange les pointeurs sur les deux tableaux
-        float *tmp = W;
-        W = Wprec;
-        Wprec = tmp;
-
-        // Va faire un || sur toutes les valeurs modif,
+        // Va faire un || sur toutes les valeurs modif de la dernière
+        // itération avant le prochain échange,
         // si toutes les valeurs sont 0 alors le programme est terminé
-        MPI_Allreduce(&modif, &running, 1, MPI_C_BOOL,
-                      MPI_LOR, MPI_COMM_WORLD);
+        t = trace_begin();
+        running = convergence_check(&conv, modif);
+        trace_end("reduction", t, t0);
         // Donc si running == 0, alors le programme sera terminé
 
+        // la charge se concentre sur les cuvettes pas encore remplies :
+        // les bandes de lignes suivent les tuiles encore modifiées
+        if (running && rebalance > 0 && !shared &&
+            (step / period) % rebalance == 0)
+        {
+            t = trace_begin();
+            if (rebalance_rows(m, dc, W, changed, &active, &final,
+                               ntiles, step, ws))
+            {
+                nrows = m->nrows;
+                own_end = nrows - dc->down;
+                nbands = fused_bands(nrows, ncols, period);
+            }
+            trace_end("rebalance", t, step);
+        }
+
     }
     // fin du while principal
 
 
-    // fin du calcul, le résultat se trouve dans W
-    free(Wprec);
-    // crée la structure résultat et la renvoie
-    mnt *res;
-    CHECK((res = malloc(sizeof(*res))) != NULL);
-    memcpy(res, m, sizeof(*res));
-    res->terrain = W;
+    // fin du calcul, le résultat se trouve dans W[step % 2]
+    ws->iterations = step;
+    return (W[step % 2]);
+}
+
+// directions de balayage du mode sweep : chaque direction propage en une
+// seule passe les baisses de niveau vers le bas (FORWARD), le haut
+// (BACKWARD), la droite (COLUMNS_FORWARD) ou la gauche (COLUMNS_BACKWARD)
+enum sweep_direction
+{
+    SWEEP_FORWARD,
+    SWEEP_BACKWARD,
+    SWEEP_COLUMNS_FORWARD,
+    SWEEP_COLUMNS_BACKWARD,
+    SWEEP_DIRECTIONS
+};
+
+// version en place de calcul_Wij : les voisins sont lus dans W lui-même et
+// peuvent donc déjà avoir été abaissés pendant ce balayage. Chaque nouvelle
+// valeur reste un majorant du résultat final et le point fixe est le même que
+// celui de calcul_Wij, le résultat est donc identique (voir darboux_flood.c)
+// Une case finale (voir FINAL_BIT) n'est pas relue, une case qui atteint le
+// terrain le devient.
+static inline int sweep_Wij(float *restrict W, uint64_t *restrict final,
+                            const mnt *m, const int ntiles,
+                            const int i, const int j)
+{
+    const int ncols = m->ncols;
+    uint64_t *restrict word = &ACTIVE(final, i, j / ACTIVE_TILE_COLS);
+    if (*word & FINAL_BIT(j))
+        return (0);
+
+    const float z = TERRAIN(m, i, j);
+    const float w = WTERRAIN(W, i, j);
+
+    if (!(w > z))
+    {
+        *word |= FINAL_BIT(j);
+        return (0);
+    }
+
+    float nw = w;
+    for (int v = 0; v < 8; v++)
+    {
+        const int n1 = i + VOISINS[v][0];
+        const int n2 = j + VOISINS[v][1];
+
+        if (WTERRAIN(W, n1, n2) == m->no_data)
+            continue;
+
+        // même temporaire que dans calcul_Wij pour les mêmes arrondis
+        const float Wn = WTERRAIN(W, n1, n2) + EPSILON;
+        if (z >= Wn)
+        {
+            nw = z;
+            break;
+        } else if (nw > Wn)
+            nw = Wn;
+    }
+
+    WTERRAIN(W, i, j) = nw;
+    if (!(nw > z))
+        *word |= FINAL_BIT(j);
+    return (nw < w);
+}
+
+// balaie en place les lignes [i_start, i_end) dans la direction dir,
+// renvoie le nombre de cases modifiées. Les mots de final sont ceux d'une
+// ligne : deux bandes n'en partagent aucun.
+static long sweep_band(float *restrict W, uint64_t *restrict final,
+                       const mnt *m, const int ntiles, const int i_start,
+                       const int i_end, const int j_start, const int j_end,
+                       const enum sweep_direction dir)
+{
+    long modif = 0;
+
+    switch (dir)
+    {
+        case SWEEP_FORWARD:
+            for (int i = i_start; i < i_end; i++)
+                for (int j = j_start; j < j_end; j++)
+                    modif += sweep_Wij(W, final, m, ntiles, i, j);
+            break;
+        case SWEEP_BACKWARD:
+            for (int i = i_end - 1; i >= i_start; i--)
+                for (int j = j_end - 1; j >= j_start; j--)
+                    modif += sweep_Wij(W, final, m, ntiles, i, j);
+            break;
+        case SWEEP_COLUMNS_FORWARD:
+            for (int j = j_start; j < j_end; j++)
+                for (int i = i_start; i < i_end; i++)
+                    modif += sweep_Wij(W, final, m, ntiles, i, j);
+            break;
+        case SWEEP_COLUMNS_BACKWARD:
+            for (int j = j_end - 1; j >= j_start; j--)
+                for (int i = i_end - 1; i >= i_start; i--)
+                    modif += sweep_Wij(W, final, m, ntiles, i, j);
+            break;
+        default:
+            break;
+    }
+    return (modif);
+}
+
+// un balayage en place des lignes [i_start, i_end) x [j_start, j_end) dans la
+// direction dir, découpées en nbands bandes traitées en deux phases (bandes
+// paires puis impaires, ordre rouge-noir) : deux bandes voisines ne sont
+// jamais balayées en même temps. Renvoie le nombre de cases modifiées.
+static long sweep_once(float *restrict W, uint64_t *restrict final,
+                       const mnt *m, const int ntiles, const int i_start,
+                       const int i_end, const int j_start, const int j_end,
+                       const int nbands, const enum sweep_direction dir)
+{
+    long modif = 0;
+
+#pragma omp parallel default(none) shared(W, final, m, ntiles, i_start, i_end, j_start, j_end, nbands, dir) reduction(+:modif)
+    for (int phase = 0; phase < 2; phase++)
+    {
+        // barrière implicite en fin de boucle : les bandes impaires
+        // voient les bandes paires déjà mises à jour
+#pragma omp for schedule(static)
+        for (int b = phase; b < nbands; b += 2)
+        {
+            const int rows = i_end - i_start;
+            modif += sweep_band(W, final, m, ntiles,
+                                i_start + b * rows / nbands,
+                                i_start + (b + 1) * rows / nbands,
+                                j_start, j_end, dir);
+        }
+    }
+    return (modif);
+}
+
+// bandes de lignes des balayages, au moins une ligne par bande
+static int sweep_bands(const int rows)
+{
+    const int nbands = 2 * omp_get_max_threads();
+    return (nbands < rows ? nbands : rows);
+}
+
+// balaie en place les cases [i_start, i_end) x [j_start, j_end) de W jusqu'à
+// stabilité, les cases autour restant fixes : W doit être un majorant du
+// résultat (voir sweep_Wij). Renvoie 1 s'il y a eu une modification.
+bool darboux_relax(float *restrict W, const mnt *m, const int i_start,
+                   const int i_end, const int j_start, const int j_end)
+{
+    bool modif = 0;
+    if (i_end <= i_start || j_end <= j_start)
+        return (0);
+
+    const int ntiles = (m->ncols + ACTIVE_TILE_COLS - 1) / ACTIVE_TILE_COLS;
+    uint64_t *restrict final;
+    CHECK((final = malloc((size_t) m->nrows * ntiles * sizeof(uint64_t)))
+          != NULL);
+    final_mask(final, W, m, ntiles);
+    const int nbands = sweep_bands(i_end - i_start);
+    for (int iter = 0; ; iter++)
+    {
+        if (sweep_once(W, final, m, ntiles, i_start, i_end, j_start, j_end,
+                       nbands, iter % SWEEP_DIRECTIONS) == 0)
+            break;
+        modif = 1;
+    }
+    free(final);
+    return (modif);
+}
+
+// applique l'algorithme de Darboux sur le MNT m en mettant à jour W en place
+// (Gauss-Seidel) avec des directions de balayage alternées : une baisse de
+// niveau traverse toute une bande en un seul balayage au lieu d'une case par
+// itération, et un seul tableau est utilisé au lieu de deux (voir
+// sweep_once). Le résultat est rendu dans W[0] de ws.
+float *darboux_sweep(const mnt *restrict m, const decomp *dc, const int check,
+                     const bool guess, workspace *ws)
+{
+    const int ncols = m->ncols, nrows = m->nrows;
+
+    // initialisation
+    float *restrict W = init_W(m, guess, NULL, ws, dc->comm);
+    const int ntiles = (ncols + ACTIVE_TILE_COLS - 1) / ACTIVE_TILE_COLS;
+    uint64_t *restrict final = final_mask(
+        workspace_get(ws, WS_FINAL, (size_t) nrows * ntiles * sizeof(uint64_t)),
+        W, m, ntiles);
+
+    // set start and end indexes for nrows and ncols loops (owned cells)
+    const int i_start = dc->up, i_end = nrows - dc->down;
+    const int j_start = dc->left, j_end = ncols - dc->right;
+    const int nbands = sweep_bands(i_end - i_start);
+
+    bool modif = true, running = true;
+    int iter = 0;
+    convergence conv;
+    convergence_init(&conv, dc->comm, check);
+
+    while (running)
+    {
+        const enum sweep_direction dir = iter % SWEEP_DIRECTIONS;
+
+        double t = trace_begin();
+        decomp_exchange(dc, W);
+        trace_end("exchange", t, iter);
+        t = trace_begin();
+        const long modified = sweep_once(W, final, m, ntiles, i_start, i_end,
+                                         j_start, j_end, nbands, dir);
+        trace_end("compute", t, iter);
+        trace_count("modified", t, modified);
+        modif = modified != 0;
+
+        // Va faire un || sur toutes les valeurs modif,
+        // si toutes les valeurs sont 0 alors le programme est terminé
+        t = trace_begin();
+        running = convergence_check(&conv, modif);
+        trace_end("reduction", t, iter);
+        iter++;
+    }
+    ws->iterations = iter;
+    return (W);
+}
+
+/*****************************************************************************/
+/*                  Mode entier en virgule fixe (moteur fixed)               */
+/*****************************************************************************/
+// Les hauteurs sont des entiers de centimètres (voir mnt_to_fixed()) et
+// EPSILON vaut 1 : les calculs sont exacts, le résultat ne dépend ni des
+// options de compilation ni du nombre de threads ou de processus. Sans
+// arrondi, la mise à jour de calcul_Wij s'écrit
+//   W = max(Z, min(Wprec, voisins connus + EPSILON))
+// qui a le même point fixe maximal (voir darboux_flood.c), en min/max
+// entiers que le compilateur vectorise sans comparaison flottante.
+
+// EPSILON en centimètres
+#define FIXED_EPSILON 1
+
+// un voisin de valeur wv : no_data est neutre pour le min
+static inline int32_t fixed_voisin(const int32_t wv)
+{
+    return (wv == MNT_FIXED_NO_DATA ? INT32_MAX : wv + FIXED_EPSILON);
+}
+
+static inline int32_t fixed_min(const int32_t a, const int32_t b)
+{
+    return (a < b ? a : b);
+}
+
+// W de départ : le terrain sur les bords et les no_data, max + 10 m ailleurs
+// (max de toute la grille, comme init_W), dans W
+static int32_t *fixed_init(int32_t *restrict W, const int32_t *restrict Z,
+                           const int nrows, const int ncols, MPI_Comm comm)
+{
+    int32_t max = MNT_FIXED_NO_DATA;
+#pragma omp parallel for reduction(max: max) schedule(static)
+    for (int i = 0; i < nrows * ncols; i++)
+        max = Z[i] > max ? Z[i] : max;
+    MPI_Allreduce(MPI_IN_PLACE, &max, 1, MPI_INT32_T, MPI_MAX, comm);
+    max += 10 * MNT_FIXED_SCALE;
+
+#pragma omp parallel for default(none) shared(W, Z, nrows, ncols, max) schedule(static)
+    for (int i = 0; i < nrows; i++)
+        for (int j = 0; j < ncols; j++)
+            WTERRAIN(W, i, j) = (i == 0 || i == nrows - 1 || j == 0 ||
+                                 j == ncols - 1 ||
+                                 WTERRAIN(Z, i, j) == MNT_FIXED_NO_DATA)
+                                ? WTERRAIN(Z, i, j) : max;
+    return (W);
+}
+
+// calcul_row en entiers sur les cases [j_first, j_last) de la ligne i (mêmes
+// conditions) : les cases no_data (Z = Wprec = MNT_FIXED_NO_DATA) et celles
+// déjà au niveau du terrain gardent leur valeur. Renvoie le nombre de cases
+// modifiées.
+__attribute__((noinline))
+static int fixed_row(int32_t *restrict W, const int32_t *restrict Wprec,
+                     const int32_t *restrict Z, const int ncols, const int i,
+                     const int j_first, const int j_last)
+{
+    const int32_t *restrict z = &WTERRAIN(Z, i, 0);
+    const int32_t *restrict up = &WTERRAIN(Wprec, i - 1, 0);
+    const int32_t *restrict mid = &WTERRAIN(Wprec, i, 0);
+    const int32_t *restrict down = &WTERRAIN(Wprec, i + 1, 0);
+    int32_t *restrict out = &WTERRAIN(W, i, 0);
+    int modif = 0;
+
+#pragma omp simd reduction(+:modif)
+    for (int j = j_first; j < j_last; j++)
+    {
+        int32_t w = mid[j];
+        w = fixed_min(w, fixed_voisin(up[j - 1]));
+        w = fixed_min(w, fixed_voisin(up[j]));
+        w = fixed_min(w, fixed_voisin(up[j + 1]));
+        w = fixed_min(w, fixed_voisin(mid[j - 1]));
+        w = fixed_min(w, fixed_voisin(mid[j + 1]));
+        w = fixed_min(w, fixed_voisin(down[j - 1]));
+        w = fixed_min(w, fixed_voisin(down[j]));
+        w = fixed_min(w, fixed_voisin(down[j + 1]));
+        w = w > z[j] ? w : z[j];
+        out[j] = w;
+        modif += (w != mid[j]);
+    }
+    return (modif);
+}
+
+// compute_tiles entier sur les cases intérieures de la ligne i (colonnes
+// [1, ncols - 1)) ; renvoie le nombre de cases modifiées
+static int fixed_tiles(int32_t *restrict W, const int32_t *restrict Wprec,
+                       const int32_t *restrict Z, const int ncols,
+                       const unsigned char *restrict active,
+                       unsigned char *restrict changed, const int ntiles,
+                       const int i)
+{
+    int modif = 0;
+
+    memset(&ACTIVE(changed, i, 0), 0, ntiles);
+    for (int t = 0; t < ntiles; t++)
+    {
+        if (!ACTIVE(active, i, t))
+            continue;
+
+        const int j_first = t * ACTIVE_TILE_COLS > 1 ?
+                            t * ACTIVE_TILE_COLS : 1;
+        const int j_last = (t + 1) * ACTIVE_TILE_COLS < ncols - 1 ?
+                           (t + 1) * ACTIVE_TILE_COLS : ncols - 1;
+        if (j_last <= j_first)
+            continue;
+        const int tile_modif = fixed_row(W, Wprec, Z, ncols, i,
+                                         j_first, j_last);
+        ACTIVE(changed, i, t) = (tile_modif != 0);
+        modif += tile_modif;
+    }
+    return (modif);
+}
+
+// applique l'algorithme de Darboux sur le MNT m en entiers (jacobi, halo de
+// profondeur 1, tuiles actives comme darboux()) ; le résultat est rendu en
+// flottants, au centimètre près, dans ws à la place du terrain entier.
+float *darboux_fixed(const mnt *restrict m, const decomp *dc, const int check,
+                     workspace *ws)
+{
+    const int ncols = m->ncols, nrows = m->nrows;
+    const size_t cells = (size_t) nrows * ncols;
+
+    // entiers et flottants ont la même taille : les grilles de ws servent
+    int32_t *restrict Z, *W[2];
+    Z = (int32_t *) workspace_grid(ws, WS_FIXED, nrows, ncols);
+    mnt_to_fixed(Z, m->terrain, cells, m->no_data);
+    // les bords et les no_data ne sont jamais recalculés : les deux tableaux
+    // partent du même état
+    W[0] = fixed_init((int32_t *) workspace_grid(ws, WS_W0, nrows, ncols), Z,
+                      nrows, ncols, dc->comm);
+    W[1] = (int32_t *) workspace_grid(ws, WS_W1, nrows, ncols);
+    memcpy(W[1], W[0], cells * sizeof(int32_t));
+
+    // tuiles actives (voir darboux()) : les drapeaux des lignes fantômes et
+    // des bords, jamais recalculées, restent à 1
+    const int ntiles = (ncols + ACTIVE_TILE_COLS - 1) / ACTIVE_TILE_COLS;
+    const size_t flags = (size_t) nrows * ntiles;
+    unsigned char *restrict active = workspace_get(ws, WS_ACTIVE, flags);
+    unsigned char *changed[2] = {workspace_get(ws, WS_CHANGED0, flags),
+                                 workspace_get(ws, WS_CHANGED1, flags)};
+    memset(changed[0], 1, flags);
+    memset(changed[1], 1, flags);
+
+    bool running = true;
+    int step = 0;
+    convergence conv;
+    convergence_init(&conv, dc->comm, check);
+
+    while (running)
+    {
+        int32_t *in = W[step % 2], *out = W[(step + 1) % 2];
+        unsigned char *ch = changed[(step + 1) % 2];
+
+        // les types de halo sont des MPI_FLOAT : des entiers de même
+        // taille, copiés tels quels
+        double t = trace_begin();
+        decomp_exchange(dc, (float *) in);
+        trace_end("exchange", t, step);
+
+        // les colonnes fantômes viennent d'être reçues
+        t = trace_begin();
+        mark_active(active, changed[step % 2], nrows, ntiles, 1, nrows - 1);
+        force_active(active, ntiles, 1, nrows - 1, 1, 1 + dc->left);
+        force_active(active, ntiles, 1, nrows - 1, ncols - 1 - dc->right,
+                     ncols - 1);
+
+        long modified = 0;
+#pragma omp parallel for reduction(+:modified) default(none) shared(in, out, Z, ncols, nrows, active, ch, ntiles) schedule(static)
+        for (int i = 1; i < nrows - 1; i++)
+            modified += fixed_tiles(out, in, Z, ncols, active, ch, ntiles, i);
+        trace_end("compute", t, step);
+        trace_count("modified", t, modified);
+
+        t = trace_begin();
+        running = convergence_check(&conv, modified != 0);
+        trace_end("reduction", t, step);
+        step++;
+    }
+    ws->iterations = step;
+
+    // le terrain entier n'est plus lu : il laisse la place au résultat
+    float *res = (float *) Z;
+    mnt_from_fixed(res, W[step % 2], cells, m->no_data);
     return (res);
 }
+
+// vérifie exactement le résultat W (flottants) du moteur fixed sur le bloc
+// local de m : chaque case possédée hors bords et no_data doit valoir
+//   max(Z, min(max + 10 m, voisins connus + EPSILON))
+// en centimètres (voir darboux_verify()). Renvoie le résultat de tous les
+// processus.
+bool darboux_fixed_verify(const mnt *m, const decomp *dc, float *W)
+{
+    const int ncols = m->ncols;
+    const size_t cells = (size_t) m->nrows * ncols;
+    int32_t *restrict Z, *restrict F;
+
+    decomp_exchange(dc, W);
+    CHECK((Z = malloc(cells * sizeof(int32_t))) != NULL);
+    CHECK((F = malloc(cells * sizeof(int32_t))) != NULL);
+    mnt_to_fixed(Z, m->terrain, cells, m->no_data);
+    mnt_to_fixed(F, W, cells, m->no_data);
+
+    int32_t max = MNT_FIXED_NO_DATA;
+    for (size_t k = 0; k < cells; k++)
+        max = Z[k] > max ? Z[k] : max;
+    MPI_Allreduce(MPI_IN_PLACE, &max, 1, MPI_INT32_T, MPI_MAX, dc->comm);
+    max += 10 * MNT_FIXED_SCALE;
+
+    // cases possédées hors bords de la grille complète
+    const int i0 = dc->up + (dc->row0 == 0);
+    const int i1 = m->nrows - dc->down - (dc->row0 + dc->nrows == dc->gnrows);
+    const int j0 = dc->left + (dc->col0 == 0);
+    const int j1 = ncols - dc->right - (dc->col0 + dc->ncols == dc->gncols);
+
+    bool ok = true;
+#pragma omp parallel for reduction(&&:ok) schedule(static)
+    for (int i = i0; i < i1; i++)
+        for (int j = j0; j < j1; j++)
+        {
+            const int32_t z = WTERRAIN(Z, i, j);
+            if (z == MNT_FIXED_NO_DATA)
+                continue;
+
+            int32_t w = max;
+            for (int v = 0; v < 8; v++)
+                w = fixed_min(w, fixed_voisin(WTERRAIN(F, i + VOISINS[v][0],
+                                                       j + VOISINS[v][1])));
+            ok = ok && WTERRAIN(F, i, j) == (w > z ? w : z);
+        }
+
+    free(Z);
+    free(F);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_C_BOOL, MPI_LAND, dc->comm);
+    return (ok);
+}
@@ -1,13 +1,27 @@
 #ifndef __DARBOUX_H__
 #define __DARBOUX_H__
 
+#include <stdbool.h>
+
 #include "type.h"
+#include "decomp.h"
+#include "workspace.h"
 
 #define EPSILON .01
 
-// Acceder aux variables du main.c
-extern int rank, size;
+float *darboux_alloc(int nrows, int ncols);
+float max_terrain(const mnt *restrict m);
 
-mnt *darboux(const mnt *restrict m);
+// moteurs itératifs : tableaux pris dans ws, résultat rendu dans ws (valable
+// jusqu'au calcul suivant) et nombre d'itérations dans ws->iterations
+float *darboux(mnt *m, decomp *dc, const bool nonblocking, const int check,
+               const int rebalance, const bool guess, workspace *ws);
+float *darboux_sweep(const mnt *restrict m, const decomp *dc, const int check,
+                     const bool guess, workspace *ws);
+float *darboux_fixed(const mnt *restrict m, const decomp *dc, const int check,
+                     workspace *ws);
+bool darboux_fixed_verify(const mnt *m, const decomp *dc, float *W);
+bool darboux_relax(float *restrict W, const mnt *m, int i_start, int i_end,
+                   int j_start, int j_end);
 
 #endif
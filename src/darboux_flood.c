@@ -0,0 +1,321 @@
+// moteur de remplissage par inondation prioritaire (priority-flood)
+// calcule le même MNT que darboux_seq() en O(n log n) au lieu de
+// O(itérations * n) : les cases sont fixées par ordre de hauteur croissante
+// depuis les bords, comme un algorithme de Dijkstra.
+#include <string.h>
+
+#include "check.h"
+#include "type.h"
+#include "darboux.h"
+#include "darboux_flood.h"
+
+// pour accéder à un tableau de flotant linéarisé (ncols doit être défini) :
+#define WTERRAIN(w, i, j) (w[(i)*ncols+(j)])
+
+// pour parcourir les 8 voisins :
+static const int VOISINS_FLOOD[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1},
+                                        {0,  1},  {1, -1}, {1,  0}, {1,  1}};
+
+// case en attente dans la file de priorité
+typedef struct cell_t
+{
+    float w; // hauteur d'eau définitive de la case
+    int idx; // position linéarisée (i * ncols + j)
+}
+cell;
+
+// tas binaire min sur cell.w ; chaque case y entre au plus une fois, la
+// capacité est donc connue dès le départ
+typedef struct heap_t
+{
+    cell *data;
+    int len;
+}
+heap;
+
+static void heap_push(heap *h, const float w, const int idx)
+{
+    int k = h->len++;
+    while (k > 0)
+    {
+        const int parent = (k - 1) / 2;
+        if (h->data[parent].w <= w)
+            break;
+        h->data[k] = h->data[parent];
+        k = parent;
+    }
+    h->data[k].w = w;
+    h->data[k].idx = idx;
+}
+
+static cell heap_pop(heap *h)
+{
+    const cell top = h->data[0];
+    const cell last = h->data[--h->len];
+    int k = 0;
+    for (;;)
+    {
+        int child = 2 * k + 1;
+        if (child >= h->len)
+            break;
+        if (child + 1 < h->len && h->data[child + 1].w < h->data[child].w)
+            child++;
+        if (last.w <= h->data[child].w)
+            break;
+        h->data[k] = h->data[child];
+        k = child;
+    }
+    h->data[k] = last;
+    return (top);
+}
+
+// calcule la valeur max de hauteur sur un terrain
+static float max_terrain_flood(const mnt *restrict m)
+{
+    float max = m->terrain[0];
+    for (int i = 0; i < m->ncols * m->nrows; i++)
+        if (m->terrain[i] > max)
+            max = m->terrain[i];
+    return (max);
+}
+
+// applique l'algorithme de Darboux sur le MNT m par inondation prioritaire.
+// Le point fixe atteint par calcul_Wij() est, en chaque case,
+//   W = terrain               si terrain >= W[voisin] + EPSILON
+//   W = min(max + 10, min sur les voisins de W[voisin] + EPSILON) sinon,
+// les bords et les voisins no_data étant exclus. Une fois les cases triées
+// par W croissant, la valeur d'une case ne dépend que de voisins déjà fixés :
+// on la calcule donc une seule fois, avec exactement les mêmes opérations
+// flottantes que calcul_Wij() pour obtenir un résultat identique au bit près.
+// Les tableaux sont pris dans ws, le résultat y est rendu.
+float *darboux_flood(const mnt *restrict m, workspace *ws)
+{
+    const int ncols = m->ncols, nrows = m->nrows;
+    const size_t cells = (size_t) ncols * nrows;
+    const float max = max_terrain_flood(m) + 10.f;
+
+    float *restrict W = workspace_get(ws, WS_W0, cells * sizeof(float));
+    unsigned char *restrict closed = workspace_get(ws, WS_ACTIVE, cells);
+    heap h;
+    h.data = workspace_get(ws, WS_STEPS, cells * sizeof(cell));
+    h.len = 0;
+
+    // initialisation : mêmes valeurs de départ que init_W_seq(), les bords
+    // connus servent de points de départ de l'inondation
+    for (int i = 0; i < nrows; i++)
+    {
+        for (int j = 0; j < ncols; j++)
+        {
+            const float z = TERRAIN(m, i, j);
+            if (z == m->no_data)
+            {
+                WTERRAIN(W, i, j) = z;
+                WTERRAIN(closed, i, j) = 1;
+            } else if (i == 0 || i == nrows - 1 || j == 0 || j == ncols - 1)
+            {
+                WTERRAIN(W, i, j) = z;
+                WTERRAIN(closed, i, j) = 1;
+                heap_push(&h, z, i * ncols + j);
+            } else
+            {
+                // reste à max si la case n'est reliée à aucun bord
+                WTERRAIN(W, i, j) = max;
+                WTERRAIN(closed, i, j) = 0;
+            }
+        }
+    }
+
+    // calcul : on fixe les cases par hauteur d'eau croissante
+    while (h.len > 0)
+    {
+        const cell c = heap_pop(&h);
+        const int i = c.idx / ncols, j = c.idx % ncols;
+
+        // il est important de mettre cette valeur dans un temporaire, sinon le
+        // compilo fait des arrondis flotants divergents dans les tests ci-dessous
+        const float Wn = c.w + EPSILON;
+
+        for (int v = 0; v < 8; v++)
+        {
+            const int n1 = i + VOISINS_FLOOD[v][0];
+            const int n2 = j + VOISINS_FLOOD[v][1];
+            if (n1 < 0 || n1 >= nrows || n2 < 0 || n2 >= ncols ||
+                WTERRAIN(closed, n1, n2))
+                continue;
+
+            // premier voisin fixé = plus petit W[voisin] : c'est la valeur
+            // finale de la case (mêmes tests que calcul_Wij)
+            float w;
+            if (TERRAIN(m, n1, n2) >= Wn)
+                w = TERRAIN(m, n1, n2);
+            else if (max > Wn)
+                w = Wn;
+            else
+                w = max;
+
+            WTERRAIN(W, n1, n2) = w;
+            WTERRAIN(closed, n1, n2) = 1;
+            heap_push(&h, w, n1 * ncols + n2);
+        }
+    }
+
+    ws->iterations = 1; // une seule passe sur les cases
+    return (W);
+}
+
+// case non no_data hors des bords de la grille : sa valeur est calculée
+#define INTERIOR(m, i, j) ((i) > 0 && (i) < (m)->nrows - 1 && (j) > 0 && \
+                           (j) < (m)->ncols - 1 &&                       \
+                           TERRAIN(m, i, j) != (m)->no_data)
+
+// ajoute idx au tas, qui grandit au besoin (une case peut y entrer
+// plusieurs fois, une par baisse de sa valeur)
+static void refill_push(heap *h, workspace *ws, const float w, const int idx)
+{
+    h->data = workspace_grow(ws, WS_STEPS, (h->len + 1) * sizeof(cell));
+    heap_push(h, w, idx);
+}
+
+// la valeur de la case (i, j) peut-elle monter : son plus bas voisin (hors
+// no_data) est-il marqué ?
+static bool lowest_marked(const mnt *restrict m, const float *restrict W,
+                          const unsigned int *restrict marks,
+                          const unsigned int gen, const int i, const int j)
+{
+    const int ncols = m->ncols;
+    float low = 0;
+    bool any = false, marked = false;
+    for (int v = 0; v < 8; v++)
+    {
+        const int n = (i + VOISINS_FLOOD[v][0]) * ncols + j +
+                      VOISINS_FLOOD[v][1];
+        if (W[n] == m->no_data)
+            continue;
+        if (!any || W[n] < low)
+        {
+            low = W[n];
+            marked = false;
+        }
+        any = true;
+        marked = marked || (W[n] == low && marks[n] == gen);
+    }
+    return (marked);
+}
+
+// remplissage incrémental après une modification du terrain de m dans la
+// boîte [i0, i1) x [j0, j1) : W, résultat pour l'ancien terrain, devient
+// celui du nouveau, au bit près comme darboux_flood(). max : max + 10 des
+// deux terrains, qui doit être le même.
+// Seules les cases dont le plus bas voisin est dans la boîte, puis de proche
+// en proche celles dont le plus bas voisin est l'une d'elles (les bassins
+// qui s'y déversent), peuvent monter : elles repartent de max. Hors d'elles,
+// W vérifie toujours les équations (voir darboux_verify()) : c'est donc un
+// majorant du résultat, qu'une inondation depuis leur pourtour, où une case
+// n'est reprise que si sa valeur baisse, amène à l'unique solution en ne
+// parcourant que les cases touchées. Renvoie leur nombre.
+long darboux_refill(const mnt *restrict m, float *restrict W, const float max,
+                    const int i0, const int i1, const int j0, const int j1,
+                    workspace *ws)
+{
+    const int ncols = m->ncols, nrows = m->nrows;
+
+    // cases qui peuvent monter, marquées de la génération gen ; les marques
+    // ne sont remises à 0 qu'au retour à la génération 0
+    unsigned int *restrict marks =
+        (unsigned int *) workspace_grid(ws, WS_MARKS, nrows, ncols);
+    unsigned int gen = ++ws->generation;
+    if (gen == 0)
+    {
+        memset(marks, 0, (size_t) nrows * ncols * sizeof(unsigned int));
+        gen = ++ws->generation;
+    }
+
+    int *list = NULL;
+    long n = 0;
+    for (int i = i0; i < i1; i++)
+        for (int j = j0; j < j1; j++)
+        {
+            list = workspace_grow(ws, WS_LIST, (n + 1) * sizeof(int));
+            list[n++] = i * ncols + j;
+            marks[i * ncols + j] = gen;
+        }
+    for (long k = 0; k < n; k++)
+    {
+        const int i = list[k] / ncols, j = list[k] % ncols;
+        for (int v = 0; v < 8; v++)
+        {
+            const int a = i + VOISINS_FLOOD[v][0], b = j + VOISINS_FLOOD[v][1];
+            if (a < 0 || a >= nrows || b < 0 || b >= ncols ||
+                marks[a * ncols + b] == gen || !INTERIOR(m, a, b) ||
+                !lowest_marked(m, W, marks, gen, a, b))
+                continue;
+            list = workspace_grow(ws, WS_LIST, (n + 1) * sizeof(int));
+            list[n++] = a * ncols + b;
+            marks[a * ncols + b] = gen;
+        }
+    }
+
+    // départ : max dans les cases marquées (le terrain sur les bords et les
+    // no_data), leur pourtour et leurs bords connus comme sources
+    heap h = {.data = NULL, .len = 0};
+    for (long k = 0; k < n; k++)
+    {
+        const int i = list[k] / ncols, j = list[k] % ncols;
+        WTERRAIN(W, i, j) = INTERIOR(m, i, j) ? max : TERRAIN(m, i, j);
+    }
+    for (long k = 0; k < n; k++)
+    {
+        const int i = list[k] / ncols, j = list[k] % ncols;
+        if (TERRAIN(m, i, j) == m->no_data)
+            continue;
+        if (!INTERIOR(m, i, j))
+            refill_push(&h, ws, WTERRAIN(W, i, j), list[k]);
+        for (int v = 0; v < 8; v++)
+        {
+            const int a = i + VOISINS_FLOOD[v][0], b = j + VOISINS_FLOOD[v][1];
+            if (a >= 0 && a < nrows && b >= 0 && b < ncols &&
+                marks[a * ncols + b] != gen &&
+                TERRAIN(m, a, b) != m->no_data)
+                refill_push(&h, ws, WTERRAIN(W, a, b), a * ncols + b);
+        }
+    }
+
+    // inondation : une case n'est reprise que si sa valeur baisse, les
+    // entrées du tas devenues périmées sont sautées
+    long touched = n;
+    while (h.len > 0)
+    {
+        const cell c = heap_pop(&h);
+        if (c.w != W[c.idx])
+            continue;
+        const int i = c.idx / ncols, j = c.idx % ncols;
+
+        // même temporaire et mêmes tests que darboux_flood()
+        const float Wn = c.w + EPSILON;
+
+        for (int v = 0; v < 8; v++)
+        {
+            const int n1 = i + VOISINS_FLOOD[v][0];
+            const int n2 = j + VOISINS_FLOOD[v][1];
+            if (!INTERIOR(m, n1, n2))
+                continue;
+
+            float w;
+            if (TERRAIN(m, n1, n2) >= Wn)
+                w = TERRAIN(m, n1, n2);
+            else if (max > Wn)
+                w = Wn;
+            else
+                w = max;
+
+            if (w < WTERRAIN(W, n1, n2))
+            {
+                touched += (marks[n1 * ncols + n2] != gen);
+                WTERRAIN(W, n1, n2) = w;
+                refill_push(&h, ws, w, n1 * ncols + n2);
+            }
+        }
+    }
+    ws->iterations = 1;
+    return (touched);
+}
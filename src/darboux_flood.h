@@ -0,0 +1,13 @@
+#ifndef __DARBOUXFLOOD_H__
+#define __DARBOUXFLOOD_H__
+
+#include "type.h"
+#include "workspace.h"
+
+#define EPSILON .01
+
+float *darboux_flood(const mnt *restrict m, workspace *ws);
+long darboux_refill(const mnt *restrict m, float *restrict W, const float max,
+                    int i0, int i1, int j0, int j1, workspace *ws);
+
+#endif
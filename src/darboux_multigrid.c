@@ -0,0 +1,180 @@
+// initialisation multi-résolution des moteurs itératifs : au lieu de partir
+// de max + 10 partout, W part d'une estimation tirée de la grille remplie à
+// plus basse résolution, déjà proche du résultat.
+//  - le niveau L + 1 a une case par bloc 2 x 2 du niveau L : le max du bloc,
+//    ou no_data si le bloc en contient une (un bloc sans no_data est
+//    connexe, un chemin d'écoulement du niveau grossier en donne donc un au
+//    niveau fin, qui ne passe pas plus haut),
+//  - un pas grossier couvre au plus 2 pas fins : le niveau L + 1 est rempli
+//    avec un EPSILON LEVEL_SCALE fois plus grand (2 EPSILON plus une marge
+//    pour les arrondis), en divisant ses hauteurs par LEVEL_SCALE,
+//  - la valeur du bloc, plus un pas grossier, majore alors le résultat en
+//    chaque case fine du bloc ; les niveaux sont remplis du plus grossier au
+//    plus fin, chacun en partant du majorant donné par le précédent.
+// Partir d'un majorant donne exactement le même point fixe que partir de
+// max + 10 (voir darboux_flood.c). Le raisonnement suppose des calculs
+// exacts : darboux_verify() contrôle le résultat et le moteur recommence
+// depuis max + 10 s'il le faut (voir main.c).
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "check.h"
+#include "type.h"
+#include "darboux.h"
+#include "darboux_multigrid.h"
+
+// rapport des EPSILON de deux niveaux successifs
+#define LEVEL_SCALE 2.5f
+
+// pas de niveau plus grossier en dessous de cette taille
+#define LEVEL_MIN_SIZE 16
+
+// pour accéder à un tableau de flotant linéarisé (ncols doit être défini) :
+#define WTERRAIN(w, i, j) (w[(i)*ncols+(j)])
+
+// niveau grossier de m : max des blocs 2 x 2, hauteurs / LEVEL_SCALE
+static mnt *coarsen(const mnt *m)
+{
+    mnt *c;
+    CHECK((c = malloc(sizeof(*c))) != NULL);
+    memcpy(c, m, sizeof(*c));
+    c->nrows = (m->nrows + 1) / 2;
+    c->ncols = (m->ncols + 1) / 2;
+    c->mapping = NULL;
+    CHECK((c->terrain = malloc((size_t) c->nrows * c->ncols * sizeof(float)))
+          != NULL);
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < c->nrows; i++)
+        for (int j = 0; j < c->ncols; j++)
+        {
+            float z = -INFINITY;
+            for (int a = 2 * i; a < 2 * i + 2 && a < m->nrows; a++)
+                for (int b = 2 * j; b < 2 * j + 2 && b < m->ncols; b++)
+                {
+                    const float v = TERRAIN(m, a, b);
+                    if (v == m->no_data || z == m->no_data)
+                        z = m->no_data;
+                    else if (v > z)
+                        z = v;
+                }
+            TERRAIN(c, i, j) = (z == m->no_data) ? z : z / LEVEL_SCALE;
+        }
+    return (c);
+}
+
+// estimation de départ du niveau m : majorant du résultat, tiré du niveau
+// grossier si levels > 0, max + 10 sinon (comme init_W())
+static float *guess(const mnt *m, const int levels)
+{
+    const int ncols = m->ncols, nrows = m->nrows;
+    const float max = max_terrain(m) + 10.f;
+    float *W;
+    CHECK((W = malloc((size_t) nrows * ncols * sizeof(float))) != NULL);
+
+    mnt *c = NULL;
+    float *Wc = NULL, max_c = 0;
+    if (levels > 0 && nrows >= 2 * LEVEL_MIN_SIZE && ncols >= 2 * LEVEL_MIN_SIZE)
+    {
+        c = coarsen(m);
+        max_c = max_terrain(c) + 10.f;
+        Wc = guess(c, levels - 1);
+        darboux_relax(Wc, c, 1, c->nrows - 1, 1, c->ncols - 1);
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nrows; i++)
+        for (int j = 0; j < ncols; j++)
+        {
+            const float z = TERRAIN(m, i, j);
+            float w = max;
+            if (i == 0 || i == nrows - 1 || j == 0 || j == ncols - 1 ||
+                z == m->no_data)
+                w = z;
+            else if (c != NULL)
+            {
+                const float wc = Wc[(i / 2) * c->ncols + j / 2];
+                // bloc no_data ou jamais atteint : pas d'information ;
+                // sinon un pas grossier de marge, plus les arrondis
+                if (TERRAIN(c, i / 2, j / 2) != c->no_data && wc < max_c)
+                {
+                    const float up = wc * LEVEL_SCALE;
+                    w = up + LEVEL_SCALE * EPSILON + (up < 0 ? -up : up) * 1e-6f;
+                    if (!(w >= z) || w > max)
+                        w = max;
+                }
+            }
+            WTERRAIN(W, i, j) = w;
+        }
+
+    if (c != NULL)
+    {
+        free(Wc);
+        free(c->terrain);
+        free(c);
+    }
+    return (W);
+}
+
+// W de départ de la grille complète m (processus 0) avec levels niveaux
+// grossiers : majorant du résultat, bords et no_data aux valeurs du terrain
+float *darboux_multigrid(const mnt *m, const int levels)
+{
+    return (guess(m, levels));
+}
+
+// vérifie que W (bloc local de dc, ses halos sont échangés ici) est le
+// résultat de darboux_seq() : en chaque case intérieure, avec Wn le min sur
+// les voisins connus de W[voisin] + EPSILON,
+//   W = terrain si terrain >= Wn, W = min(max + 10, Wn) sinon
+// (voir darboux_flood.c). Ce système n'a qu'une solution, le point fixe
+// maximal ; un point fixe plus bas, atteint depuis une estimation qui n'était
+// pas un majorant, ne le vérifie pas. Renvoie le résultat de tous les
+// processus.
+bool darboux_verify(const mnt *m, const decomp *dc, float *W)
+{
+    const int ncols = m->ncols;
+    float max = max_terrain(m);
+    MPI_Allreduce(MPI_IN_PLACE, &max, 1, MPI_FLOAT, MPI_MAX, dc->comm);
+    max += 10.f;
+    decomp_exchange(dc, W);
+
+    // cases possédées hors bords de la grille complète
+    const int i0 = dc->up + (dc->row0 == 0);
+    const int i1 = m->nrows - dc->down - (dc->row0 + dc->nrows == dc->gnrows);
+    const int j0 = dc->left + (dc->col0 == 0);
+    const int j1 = ncols - dc->right - (dc->col0 + dc->ncols == dc->gncols);
+
+    bool ok = true;
+#pragma omp parallel for reduction(&&:ok) schedule(static)
+    for (int i = i0; i < i1; i++)
+        for (int j = j0; j < j1; j++)
+        {
+            const float z = TERRAIN(m, i, j);
+            if (z == m->no_data)
+                continue;
+
+            float wn = max;
+            bool any = false;
+            for (int a = i - 1; a <= i + 1; a++)
+                for (int b = j - 1; b <= j + 1; b++)
+                {
+                    if ((a == i && b == j) || WTERRAIN(W, a, b) == m->no_data)
+                        continue;
+                    // même temporaire que dans calcul_Wij
+                    const float Wn = WTERRAIN(W, a, b) + EPSILON;
+                    if (!any || Wn < wn)
+                        wn = Wn;
+                    any = true;
+                }
+
+            const float expected = !any ? max
+                                   : (z >= wn ? z : (max > wn ? wn : max));
+            ok = ok && WTERRAIN(W, i, j) == expected;
+        }
+
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_C_BOOL, MPI_LAND, dc->comm);
+    return (ok);
+}
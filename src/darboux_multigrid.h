@@ -0,0 +1,12 @@
+#ifndef __DARBOUXMULTIGRID_H__
+#define __DARBOUXMULTIGRID_H__
+
+#include <stdbool.h>
+
+#include "type.h"
+#include "decomp.h"
+
+float *darboux_multigrid(const mnt *m, int levels);
+bool darboux_verify(const mnt *m, const decomp *dc, float *W);
+
+#endif
@@ -0,0 +1,287 @@
+// mode hors mémoire (out-of-core) pour les grilles plus grandes que la RAM :
+// la grille reste sur disque, dans le fichier binaire d'entrée (terrain) et
+// dans celui de sortie (W, qui sert de stockage de travail). Elle est traitée
+// par tuiles qui tiennent dans le budget mémoire, chacune entourée d'une
+// couronne d'une case lue chez ses voisines et gardée fixe :
+//  - W est initialisé comme dans init_W() en parcourant le fichier par
+//    morceaux,
+//  - chaque tuile « sale » est chargée, balayée jusqu'à stabilité
+//    (darboux_relax) puis réécrite ; si une case de son bord a baissé, ses
+//    tuiles voisines redeviennent sales,
+//  - on recommence tant qu'il reste des tuiles sales.
+// W ne fait que baisser en restant un majorant du résultat : le point fixe
+// atteint est le même que celui de darboux_seq(), au bit près.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "type.h"
+#include "io.h"
+#include "darboux.h"
+#include "darboux_ooc.h"
+
+// grille sur disque et découpage en tuiles
+typedef struct ooc_t
+{
+    int in, out;              // file descriptors: terrain, W
+    int nrows, ncols;         // whole grid size
+    float no_data;
+    int trows, tcols;         // tile size (without the ring)
+    int ntrows, ntcols;       // tiles per column/row
+    unsigned char *dirty;     // tiles to (re)compute
+}
+ooc;
+
+// position de la case (i, j) de la grille dans un fichier binaire
+static off_t offset(const ooc *o, const int i, const int j)
+{
+    return (MNT_BINARY_HEADER + ((off_t) i * o->ncols + j) * sizeof(float));
+}
+
+static void read_all(const int fd, void *buf, size_t n, off_t pos)
+{
+    while (n > 0)
+    {
+        const ssize_t r = pread(fd, buf, n, pos);
+        CHECK(r > 0);
+        buf = (char *) buf + r;
+        n -= r;
+        pos += r;
+    }
+}
+
+static void write_all(const int fd, const void *buf, size_t n, off_t pos)
+{
+    while (n > 0)
+    {
+        const ssize_t r = pwrite(fd, buf, n, pos);
+        CHECK(r > 0);
+        buf = (const char *) buf + r;
+        n -= r;
+        pos += r;
+    }
+}
+
+// lit le rectangle [r0, r1) x [c0, c1) de la grille dans buf (lignes de
+// c1 - c0 valeurs)
+static void read_block(const ooc *o, const int fd, float *buf, const int r0,
+                       const int r1, const int c0, const int c1)
+{
+    const int n = c1 - c0;
+    for (int i = r0; i < r1; i++)
+        read_all(fd, &buf[(size_t) (i - r0) * n], n * sizeof(float),
+                 offset(o, i, c0));
+    mnt_from_little_endian(buf, (size_t) (r1 - r0) * n);
+}
+
+// écrit les lignes [r0, r1) x [c0, c1) du bloc buf, qui a ld colonnes et
+// commence en (br, bc) dans la grille ; buf est converti en place
+static void write_block(const ooc *o, float *buf, const int ld, const int br,
+                        const int bc, const int r0, const int r1,
+                        const int c0, const int c1)
+{
+    for (int i = r0; i < r1; i++)
+    {
+        float *row = &buf[(size_t) (i - br) * ld + (c0 - bc)];
+        mnt_from_little_endian(row, c1 - c0);
+        write_all(o->out, row, (c1 - c0) * sizeof(float), offset(o, i, c0));
+    }
+}
+
+// taille des tuiles : W et le terrain d'une tuile et de sa couronne tiennent
+// dans le budget (en octets)
+static void tile_size(ooc *o, const size_t budget)
+{
+    const size_t cells = budget / (2 * sizeof(float));
+    int side = 0;
+    while ((size_t) (side + 1) * (side + 1) <= cells)
+        side++;
+    side -= 2;
+
+    o->tcols = side < o->ncols ? side : o->ncols;
+    CHECK(o->tcols >= 1); // budget trop petit
+    const long rows = (long) (cells / (o->tcols + 2)) - 2;
+    o->trows = rows < o->nrows ? rows : o->nrows;
+    CHECK(o->trows >= 1);
+
+    o->ntrows = (o->nrows + o->trows - 1) / o->trows;
+    o->ntcols = (o->ncols + o->tcols - 1) / o->tcols;
+}
+
+// initialise W dans le fichier de sortie comme init_W(), par morceaux d'au
+// plus chunk valeurs : hauteur max + 10 partout, sauf sur les bords et les
+// cases no_data qui gardent celle du terrain
+static void init_W_ooc(const ooc *o, const size_t chunk)
+{
+    const size_t n = (size_t) o->nrows * o->ncols;
+    float *buf, max;
+    CHECK((buf = malloc(chunk * sizeof(float))) != NULL);
+
+    read_all(o->in, &max, sizeof(float), offset(o, 0, 0));
+    mnt_from_little_endian(&max, 1);
+    for (size_t k0 = 0; k0 < n; k0 += chunk)
+    {
+        const size_t len = (n - k0 < chunk) ? n - k0 : chunk;
+        read_all(o->in, buf, len * sizeof(float),
+                 MNT_BINARY_HEADER + k0 * sizeof(float));
+        mnt_from_little_endian(buf, len);
+        for (size_t k = 0; k < len; k++)
+            max = buf[k] > max ? buf[k] : max;
+    }
+    max += 10.f;
+
+    for (size_t k0 = 0; k0 < n; k0 += chunk)
+    {
+        const size_t len = (n - k0 < chunk) ? n - k0 : chunk;
+        read_all(o->in, buf, len * sizeof(float),
+                 MNT_BINARY_HEADER + k0 * sizeof(float));
+        mnt_from_little_endian(buf, len);
+        for (size_t k = 0; k < len; k++)
+        {
+            const int i = (k0 + k) / o->ncols, j = (k0 + k) % o->ncols;
+            if (!(i == 0 || i == o->nrows - 1 || j == 0 || j == o->ncols - 1 ||
+                  buf[k] == o->no_data))
+                buf[k] = max;
+        }
+        mnt_from_little_endian(buf, len);
+        write_all(o->out, buf, len * sizeof(float),
+                  MNT_BINARY_HEADER + k0 * sizeof(float));
+    }
+    free(buf);
+}
+
+// marque sale la tuile (ti, tj) si elle existe
+static void dirty(ooc *o, const int ti, const int tj)
+{
+    if (ti >= 0 && ti < o->ntrows && tj >= 0 && tj < o->ntcols)
+        o->dirty[ti * o->ntcols + tj] = 1;
+}
+
+// vrai si une des n valeurs espacées de stride a changé depuis la copie old
+static bool edge_changed(const float *W, const int stride, const int n,
+                         const float *old)
+{
+    for (int k = 0; k < n; k++)
+        if (W[(size_t) k * stride] != old[k])
+            return (true);
+    return (false);
+}
+
+static void edge_copy(const float *W, const int stride, const int n,
+                      float *old)
+{
+    for (int k = 0; k < n; k++)
+        old[k] = W[(size_t) k * stride];
+}
+
+// charge, balaie jusqu'à stabilité puis réécrit la tuile (ti, tj) avec les
+// tampons T, W et edges ; marque sales ses voisines si son bord a changé
+static void tile(ooc *o, const int ti, const int tj, float *T, float *W,
+                 float *edges)
+{
+    // cases possédées, puis avec la couronne (si la grille continue)
+    const int r0 = ti * o->trows, c0 = tj * o->tcols;
+    const int r1 = r0 + o->trows < o->nrows ? r0 + o->trows : o->nrows;
+    const int c1 = c0 + o->tcols < o->ncols ? c0 + o->tcols : o->ncols;
+    const int lr0 = r0 > 0 ? r0 - 1 : r0, lr1 = r1 < o->nrows ? r1 + 1 : r1;
+    const int lc0 = c0 > 0 ? c0 - 1 : c0, lc1 = c1 < o->ncols ? c1 + 1 : c1;
+    const int ld = lc1 - lc0, rows = r1 - r0, cols = c1 - c0;
+
+    read_block(o, o->in, T, lr0, lr1, lc0, lc1);
+    read_block(o, o->out, W, lr0, lr1, lc0, lc1);
+
+    mnt m;
+    m.nrows = lr1 - lr0;
+    m.ncols = ld;
+    m.no_data = o->no_data;
+    m.terrain = T;
+
+    // bords de la tuile avant le calcul : haut, bas, gauche, droite
+    float *first = &W[(size_t) (r0 - lr0) * ld + (c0 - lc0)];
+    float *last_row = first + (size_t) (rows - 1) * ld;
+    float *last_col = first + cols - 1;
+    edge_copy(first, 1, cols, edges);
+    edge_copy(last_row, 1, cols, edges + cols);
+    edge_copy(first, ld, rows, edges + 2 * cols);
+    edge_copy(last_col, ld, rows, edges + 2 * cols + rows);
+
+    if (!darboux_relax(W, &m, r0 - lr0, r1 - lr0, c0 - lc0, c1 - lc0))
+        return;
+
+    if (edge_changed(first, 1, cols, edges))
+        for (int d = -1; d <= 1; d++)
+            dirty(o, ti - 1, tj + d);
+    if (edge_changed(last_row, 1, cols, edges + cols))
+        for (int d = -1; d <= 1; d++)
+            dirty(o, ti + 1, tj + d);
+    if (edge_changed(first, ld, rows, edges + 2 * cols))
+        for (int d = -1; d <= 1; d++)
+            dirty(o, ti + d, tj - 1);
+    if (edge_changed(last_col, ld, rows, edges + 2 * cols + rows))
+        for (int d = -1; d <= 1; d++)
+            dirty(o, ti + d, tj + 1);
+
+    write_block(o, W, ld, lr0, lc0, r0, r1, c0, c1);
+}
+
+// remplit le MNT du fichier binaire input dans le fichier binaire output en
+// utilisant au plus budget octets pour la grille
+void darboux_ooc(char *input, char *output, const size_t budget)
+{
+    ooc o;
+    mnt *h = mnt_read_binary_header(input);
+    char header[MNT_BINARY_HEADER];
+
+    o.nrows = h->nrows;
+    o.ncols = h->ncols;
+    o.no_data = h->no_data;
+    tile_size(&o, budget);
+    printf("Out-of-core: %d x %d tiles of %d x %d cells.\n",
+           o.ntrows, o.ntcols, o.trows, o.tcols);
+
+    CHECK((o.in = open(input, O_RDONLY)) >= 0);
+    CHECK((o.out = open(output, O_RDWR | O_CREAT | O_TRUNC, 0644)) >= 0);
+    CHECK(ftruncate(o.out, offset(&o, o.nrows, 0)) == 0);
+    mnt_binary_header(h, header);
+    write_all(o.out, header, MNT_BINARY_HEADER, 0);
+    mnt_free(h);
+
+    init_W_ooc(&o, budget / sizeof(float));
+
+    float *T, *W, *edges;
+    const size_t cells = (size_t) (o.trows + 2) * (o.tcols + 2);
+    CHECK((T = malloc(cells * sizeof(float))) != NULL);
+    CHECK((W = malloc(cells * sizeof(float))) != NULL);
+    CHECK((edges = malloc(2 * (o.trows + o.tcols) * sizeof(float))) != NULL);
+    CHECK((o.dirty = malloc(o.ntrows * o.ntcols)) != NULL);
+    memset(o.dirty, 1, o.ntrows * o.ntcols);
+
+    // passes alternées dans les deux sens sur les tuiles sales
+    long loads = 0;
+    int passes = 0;
+    for (bool again = true; again; passes++)
+    {
+        again = false;
+        for (int k = 0; k < o.ntrows * o.ntcols; k++)
+        {
+            const int t = (passes % 2) ? o.ntrows * o.ntcols - 1 - k : k;
+            if (!o.dirty[t])
+                continue;
+            o.dirty[t] = 0;
+            tile(&o, t / o.ntcols, t % o.ntcols, T, W, edges);
+            loads++;
+            again = true;
+        }
+    }
+    printf("Out-of-core: %ld tile loads in %d passes.\n", loads, passes - 1);
+
+    CHECK(close(o.in) == 0);
+    CHECK(close(o.out) == 0);
+    free(T);
+    free(W);
+    free(edges);
+    free(o.dirty);
+}
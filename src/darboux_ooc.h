@@ -0,0 +1,8 @@
+#ifndef __DARBOUXOOC_H__
+#define __DARBOUXOOC_H__
+
+#include <stddef.h>
+
+void darboux_ooc(char *input, char *output, size_t budget);
+
+#endif
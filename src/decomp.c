@@ -0,0 +1,814 @@
+// découpage 2D de la grille sur une grille cartésienne de processus :
+// répartition des blocs, distribution/rassemblement, lecture/écriture des
+// fichiers par blocs et échange des halos
+#include <limits.h>
+#include <mpi.h>
+#include <omp.h>
+#include <string.h>
+
+#include "check.h"
+#include "decomp.h"
+#include "io.h"
+
+// directions des 8 voisins (même ordre que VOISINS dans darboux.c) :
+// le voisin opposé à la direction v est la direction 7 - v
+static const int DIRECTIONS[DECOMP_NEIGHBOURS][2] = {{-1, -1}, {-1, 0},
+                                                     {-1, 1},  {0,  -1},
+                                                     {0,  1},  {1,  -1},
+                                                     {1,  0},  {1,  1}};
+#define NORTH 1
+#define WEST 3
+#define EAST 4
+#define SOUTH 6
+
+// signaux des blocs partagés (voir shared_exchange()), après les étiquettes
+// des directions
+#define TAG_WRITTEN DECOMP_NEIGHBOURS
+#define TAG_READ (DECOMP_NEIGHBOURS + 1)
+
+// choisit la forme de la grille de processus qui minimise la longueur totale
+// des coupes (donc le volume des halos) ; à égalité, les bandes de lignes
+// sont préférées car leurs halos sont contigus
+static void choose_dims(const int size, const int gnrows, const int gncols,
+                        int dims[2])
+{
+    long best = -1;
+    for (int py = 1; py <= size; py++)
+    {
+        if (size % py != 0)
+            continue;
+        const int px = size / py;
+        if (py > gnrows || px > gncols)
+            continue;
+
+        const long cost = (long) (py - 1) * gncols + (long) (px - 1) * gnrows;
+        if (best < 0 || cost <= best)
+        {
+            best = cost;
+            dims[0] = py;
+            dims[1] = px;
+        }
+    }
+    // plus de processus que de cases
+    CHECK(best >= 0);
+}
+
+// découpe n en parts morceaux : les n % parts premiers ont une case de plus
+static void split(const int n, const int parts, const int idx,
+                  int *start, int *count)
+{
+    const int base = n / parts, rem = n % parts;
+    *count = base + (idx < rem);
+    *start = idx * base + (idx < rem ? idx : rem);
+}
+
+// bloc possédé par le processus de coordonnées coords, halos compris
+static void block(const decomp *d, const int coords[2], int *row0, int *nrows,
+                  int *col0, int *ncols, int *up, int *down, int *left,
+                  int *right)
+{
+    *row0 = d->row_starts[coords[0]];
+    *nrows = d->row_starts[coords[0] + 1] - *row0;
+    split(d->gncols, d->dims[1], coords[1], col0, ncols);
+    *up = coords[0] > 0 ? d->halo : 0;
+    *down = coords[0] < d->dims[0] - 1 ? d->halo : 0;
+    *left = coords[1] > 0 ? d->halo : 0;
+    *right = coords[1] < d->dims[1] - 1 ? d->halo : 0;
+}
+
+// sous-tableau [r0, r0 + nr) x [c0, c0 + nc) d'un tableau rows x cols
+static MPI_Datatype subarray(const int rows, const int cols, const int r0,
+                             const int nr, const int c0, const int nc)
+{
+    MPI_Datatype t;
+    int sizes[2] = {rows, cols}, subsizes[2] = {nr, nc}, starts[2] = {r0, c0};
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C,
+                             MPI_FLOAT, &t);
+    MPI_Type_commit(&t);
+    return (t);
+}
+
+// lignes (ou colonnes) échangées avec le voisin dans la direction dir
+// (-1, 0 ou 1) le long d'une dimension de taille locale n
+static void halo_range(const int dir, const int n, const int lo, const int hi,
+                       const int halo, int *recv0, int *send0, int *count)
+{
+    if (dir < 0)
+    {
+        *recv0 = 0;
+        *send0 = lo;
+        *count = lo;
+    } else if (dir > 0)
+    {
+        *recv0 = n - hi;
+        *send0 = n - hi - halo;
+        *count = hi;
+    } else
+    {
+        *recv0 = lo;
+        *send0 = lo;
+        *count = n - lo - hi;
+    }
+}
+
+// types des zones de halo échangées avec chaque voisin, pour la taille
+// actuelle du bloc local
+static void halo_types(decomp *d)
+{
+    for (int v = 0; v < DECOMP_NEIGHBOURS; v++)
+    {
+        d->send[v] = d->recv[v] = MPI_DATATYPE_NULL;
+        if (d->neighbours[v] == MPI_PROC_NULL)
+            continue;
+
+        int rr, rs, rn, cr, cs, cn;
+        halo_range(DIRECTIONS[v][0], d->lnrows, d->up, d->down, d->halo,
+                   &rr, &rs, &rn);
+        halo_range(DIRECTIONS[v][1], d->lncols, d->left, d->right, d->halo,
+                   &cr, &cs, &cn);
+        d->recv[v] = subarray(d->lnrows, d->lncols, rr, rn, cr, cn);
+        d->send[v] = subarray(d->lnrows, d->lncols, rs, rn, cs, cn);
+    }
+}
+
+static void free_types(decomp *d)
+{
+    for (int v = 0; v < DECOMP_NEIGHBOURS; v++)
+    {
+        if (d->send[v] != MPI_DATATYPE_NULL)
+            MPI_Type_free(&d->send[v]);
+        if (d->recv[v] != MPI_DATATYPE_NULL)
+            MPI_Type_free(&d->recv[v]);
+    }
+}
+
+// crée le découpage de la grille gnrows x gncols sur les processus de comm.
+// La profondeur des halos est réduite si un bloc est plus petit qu'elle :
+// d->halo contient la profondeur effective.
+int decomp_create(decomp *d, const int gnrows, const int gncols,
+                  const int halo, MPI_Comm comm)
+{
+    int periods[2] = {0, 0};
+
+    MPI_Comm_size(comm, &d->size);
+    d->gnrows = gnrows;
+    d->gncols = gncols;
+    choose_dims(d->size, gnrows, gncols, d->dims);
+
+    // pas de réordonnancement : le rang 0 reste celui qui lit la grille
+    MPI_Cart_create(comm, 2, d->dims, periods, 0, &d->comm);
+    MPI_Comm_rank(d->comm, &d->rank);
+    MPI_Cart_coords(d->comm, d->rank, 2, d->coords);
+
+    // un halo ne peut venir que du voisin direct
+    d->halo = halo;
+    if (d->dims[0] > 1 && d->halo > gnrows / d->dims[0])
+        d->halo = gnrows / d->dims[0];
+    if (d->dims[1] > 1 && d->halo > gncols / d->dims[1])
+        d->halo = gncols / d->dims[1];
+    if (d->halo < 1)
+        d->halo = 1;
+
+    // bandes de lignes égales au départ, voir decomp_rebalance()
+    CHECK((d->row_starts = malloc((d->dims[0] + 1) * sizeof(int))) != NULL);
+    for (int p = 0; p < d->dims[0]; p++)
+    {
+        int count;
+        split(gnrows, d->dims[0], p, &d->row_starts[p], &count);
+    }
+    d->row_starts[d->dims[0]] = gnrows;
+
+    block(d, d->coords, &d->row0, &d->nrows, &d->col0, &d->ncols,
+          &d->up, &d->down, &d->left, &d->right);
+    d->lnrows = d->up + d->nrows + d->down;
+    d->lncols = d->left + d->ncols + d->right;
+
+    for (int v = 0; v < DECOMP_NEIGHBOURS; v++)
+    {
+        const int c[2] = {d->coords[0] + DIRECTIONS[v][0],
+                          d->coords[1] + DIRECTIONS[v][1]};
+        if (c[0] < 0 || c[0] >= d->dims[0] || c[1] < 0 || c[1] >= d->dims[1])
+            d->neighbours[v] = MPI_PROC_NULL;
+        else
+            MPI_Cart_rank(d->comm, c, &d->neighbours[v]);
+    }
+    halo_types(d);
+    d->node = MPI_COMM_NULL;
+
+    return (d->halo);
+}
+
+void decomp_free(decomp *d)
+{
+    if (d->node != MPI_COMM_NULL)
+    {
+        MPI_Win_unlock_all(d->win);
+        MPI_Win_free(&d->win);
+        MPI_Comm_free(&d->node);
+    }
+    free_types(d);
+    free(d->row_starts);
+    MPI_Comm_free(&d->comm);
+}
+
+// distribue la grille complète global (rang 0 seulement) : chaque processus
+// reçoit son bloc local, halos compris, dans local
+void decomp_scatter(const decomp *d, const float *global, float *local)
+{
+    MPI_Request recv, *sends = NULL;
+    MPI_Irecv(local, d->lnrows * d->lncols, MPI_FLOAT, 0, 0, d->comm, &recv);
+
+    if (d->rank == 0)
+    {
+        CHECK((sends = malloc(d->size * sizeof(MPI_Request))) != NULL);
+        for (int r = 0; r < d->size; r++)
+        {
+            int c[2], row0, nrows, col0, ncols, up, down, left, right;
+            MPI_Cart_coords(d->comm, r, 2, c);
+            block(d, c, &row0, &nrows, &col0, &ncols, &up, &down, &left,
+                  &right);
+
+            // les halos de deux blocs voisins se chevauchent : un envoi par
+            // processus plutôt qu'un MPI_Scatterv
+            MPI_Datatype t = subarray(d->gnrows, d->gncols,
+                                      row0 - up, up + nrows + down,
+                                      col0 - left, left + ncols + right);
+            MPI_Isend(global, 1, t, r, 0, d->comm, &sends[r]);
+            MPI_Type_free(&t);
+        }
+    }
+
+    MPI_Wait(&recv, MPI_STATUS_IGNORE);
+    if (d->rank == 0)
+    {
+        MPI_Waitall(d->size, sends, MPI_STATUSES_IGNORE);
+        free(sends);
+    }
+}
+
+// mode mémoire partagée : les deux blocs W et Wprec de chaque processus sont
+// alloués dans une fenêtre partagée par les processus de son nœud
+// (d->shared). Un voisin du même nœud n'envoie plus ses cases par message :
+// elles sont recopiées directement de son bloc dans nos cases fantômes, entre
+// deux signaux vides échangés avec lui seul (voir shared_exchange()). Les
+// voisins des autres nœuds gardent les messages. Les blocs ne changent plus
+// de taille ensuite (decomp_rebalance() est exclu).
+void decomp_share(decomp *d)
+{
+    const MPI_Aint size = 2 * (MPI_Aint) d->lnrows * d->lncols * sizeof(float);
+    MPI_Info info;
+    float *base;
+
+    MPI_Comm_split_type(d->comm, MPI_COMM_TYPE_SHARED, d->rank,
+                        MPI_INFO_NULL, &d->node);
+
+    // chaque bloc dans ses propres pages, placées par le premier accès de
+    // son processus (voir darboux_alloc())
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    CHECK(MPI_Win_allocate_shared(size, sizeof(float), info, d->node, &base,
+                                  &d->win) == MPI_SUCCESS);
+    MPI_Info_free(&info);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, d->win);
+    d->shared[0] = base;
+    d->shared[1] = base + (size_t) d->lnrows * d->lncols;
+
+    MPI_Group all, node;
+    MPI_Comm_group(d->comm, &all);
+    MPI_Comm_group(d->node, &node);
+    for (int v = 0; v < DECOMP_NEIGHBOURS; v++)
+    {
+        int r = MPI_UNDEFINED;
+        d->peer[0][v] = d->peer[1][v] = NULL;
+        if (d->neighbours[v] != MPI_PROC_NULL)
+            MPI_Group_translate_ranks(all, 1, &d->neighbours[v], node, &r);
+        if (r == MPI_UNDEFINED)
+            continue;
+
+        // bloc du voisin et zone qu'il nous envoie (direction opposée)
+        int c[2] = {d->coords[0] + DIRECTIONS[v][0],
+                    d->coords[1] + DIRECTIONS[v][1]};
+        int row0, nrows, col0, ncols, up, down, left, right, rr, rs, rn, cr,
+            cs, cn;
+        block(d, c, &row0, &nrows, &col0, &ncols, &up, &down, &left, &right);
+        halo_range(-DIRECTIONS[v][0], up + nrows + down, up, down, d->halo,
+                   &rr, &rs, &rn);
+        halo_range(-DIRECTIONS[v][1], left + ncols + right, left, right,
+                   d->halo, &cr, &cs, &cn);
+
+        MPI_Aint bytes;
+        int unit;
+        float *peer;
+        MPI_Win_shared_query(d->win, r, &bytes, &unit, &peer);
+        const size_t cells = (size_t) (up + nrows + down) *
+                             (left + ncols + right);
+        d->peer_ld[v] = left + ncols + right;
+        d->peer[0][v] = peer + (size_t) rs * d->peer_ld[v] + cs;
+        d->peer[1][v] = peer + cells + (size_t) rs * d->peer_ld[v] + cs;
+    }
+    MPI_Group_free(&all);
+    MPI_Group_free(&node);
+}
+
+// lit le bloc local, halos compris, directement dans un fichier de flottants
+// rangés ligne par ligne à partir de offset (valeurs dans l'ordre natif des
+// octets) : chaque processus ne lit que ses cases, sans passer par le rang 0
+void decomp_read(const decomp *d, char *fname, const MPI_Offset offset,
+                 float *local)
+{
+    MPI_File f;
+    MPI_Datatype t = subarray(d->gnrows, d->gncols, d->row0 - d->up,
+                              d->lnrows, d->col0 - d->left, d->lncols);
+
+    CHECK(MPI_File_open(d->comm, fname, MPI_MODE_RDONLY, MPI_INFO_NULL, &f)
+          == MPI_SUCCESS);
+    MPI_File_set_view(f, offset, MPI_FLOAT, t, "native", MPI_INFO_NULL);
+    CHECK(MPI_File_read_all(f, local, d->lnrows * d->lncols, MPI_FLOAT,
+                            MPI_STATUS_IGNORE) == MPI_SUCCESS);
+    MPI_File_close(&f);
+    MPI_Type_free(&t);
+}
+
+// lit le bloc local, halos compris, dans un fichier tuilé (voir
+// mnt_write_tiled()) : chaque processus ne décode que les tuiles de son bloc
+void decomp_read_tiled(const decomp *d, char *fname, float *local)
+{
+    mnt_read_window(fname, d->row0 - d->up, d->lnrows, d->col0 - d->left,
+                    d->lncols, local);
+}
+
+// rassemble les cases possédées de chaque bloc local dans la grille
+// complète global (rang 0 seulement)
+void decomp_gather(const decomp *d, const float *local, float *global)
+{
+    MPI_Request send;
+    MPI_Datatype own = subarray(d->lnrows, d->lncols, d->up, d->nrows,
+                                d->left, d->ncols);
+    MPI_Isend(local, 1, own, 0, 1, d->comm, &send);
+
+    if (d->rank == 0)
+    {
+        for (int r = 0; r < d->size; r++)
+        {
+            int c[2], row0, nrows, col0, ncols, up, down, left, right;
+            MPI_Cart_coords(d->comm, r, 2, c);
+            block(d, c, &row0, &nrows, &col0, &ncols, &up, &down, &left,
+                  &right);
+
+            MPI_Datatype t = subarray(d->gnrows, d->gncols,
+                                      row0, nrows, col0, ncols);
+            MPI_Recv(global, 1, t, r, 1, d->comm, MPI_STATUS_IGNORE);
+            MPI_Type_free(&t);
+        }
+    }
+
+    MPI_Wait(&send, MPI_STATUS_IGNORE);
+    MPI_Type_free(&own);
+}
+
+// ouvre fname en écriture pour tous les processus, de taille size octets,
+// le rang 0 y écrit l'en-tête (header_size octets)
+static MPI_File create(const decomp *d, char *fname, const MPI_Offset size,
+                       const void *header, const int header_size)
+{
+    MPI_File f;
+    CHECK(MPI_File_open(d->comm, fname, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                        MPI_INFO_NULL, &f) == MPI_SUCCESS);
+    MPI_File_set_size(f, size);
+    if (d->rank == 0)
+        CHECK(MPI_File_write_at(f, 0, header, header_size, MPI_BYTE,
+                                MPI_STATUS_IGNORE) == MPI_SUCCESS);
+    return (f);
+}
+
+// écrit les cases possédées de chaque bloc local dans un fichier binaire
+// (header, MNT_BINARY_HEADER octets, n'est lu que sur le rang 0) : une vue
+// de fichier par bloc, sans rassembler la grille
+void decomp_write_binary(const decomp *d, char *fname, const void *header,
+                         const float *local)
+{
+    const MPI_Offset size = MNT_BINARY_HEADER
+                            + (MPI_Offset) d->gnrows * d->gncols * sizeof(float);
+    float *own;
+
+    // valeurs possédées, contiguës et petit-boutistes
+    CHECK((own = malloc((size_t) d->nrows * d->ncols * sizeof(float))) != NULL);
+    for (int i = 0; i < d->nrows; i++)
+        memcpy(&own[(size_t) i * d->ncols],
+               &local[(size_t) (d->up + i) * d->lncols + d->left],
+               d->ncols * sizeof(float));
+    mnt_from_little_endian(own, (size_t) d->nrows * d->ncols);
+
+    MPI_File f = create(d, fname, size, header, MNT_BINARY_HEADER);
+    MPI_Datatype t = subarray(d->gnrows, d->gncols, d->row0, d->nrows,
+                              d->col0, d->ncols);
+    MPI_File_set_view(f, MNT_BINARY_HEADER, MPI_FLOAT, t, "native",
+                      MPI_INFO_NULL);
+    CHECK(MPI_File_write_all(f, own, d->nrows * d->ncols, MPI_FLOAT,
+                             MPI_STATUS_IGNORE) == MPI_SUCCESS);
+    MPI_File_close(&f);
+    MPI_Type_free(&t);
+    free(own);
+}
+
+// écrit les cases possédées de chaque bloc local dans un fichier texte, au
+// format de mnt_write() (header, header_size octets, sur le rang 0) :
+//  - chaque processus formate ses morceaux de lignes, en parallèle par
+//    paquets de lignes consécutives ; le dernier de chaque ligne de la grille
+//    de processus ajoute les fins de ligne,
+//  - les longueurs des morceaux donnent leurs positions dans le fichier :
+//    préfixe le long de la ligne de processus, longueurs totales des lignes
+//    de la grille, puis préfixe des bandes le long de la colonne,
+//  - un type indexé décrit les morceaux dans le fichier, un autre les tampons
+//    des threads en mémoire, pour une seule écriture collective sans
+//    recopie du texte.
+void decomp_write_text(const decomp *d, char *fname, const char *header,
+                       int header_size, const float *local)
+{
+    const int last = (d->coords[1] == d->dims[1] - 1);
+    long *len, *left, *total;
+
+    CHECK((len = calloc(d->nrows, sizeof(long))) != NULL);
+    CHECK((left = calloc(d->nrows, sizeof(long))) != NULL);
+    CHECK((total = malloc(d->nrows * sizeof(long))) != NULL);
+
+    // chaque thread formate ses lignes dans son tampon, écrit tel quel
+    const int nt = omp_get_max_threads();
+    char **parts;
+    size_t *used;
+    CHECK((parts = calloc(nt, sizeof(char *))) != NULL);
+    CHECK((used = calloc(nt, sizeof(size_t))) != NULL);
+
+    #pragma omp parallel num_threads(nt)
+    {
+        const int t = omp_get_thread_num(), n = omp_get_num_threads();
+        const int i0 = (long) d->nrows * t / n;
+        const int i1 = (long) d->nrows * (t + 1) / n;
+        const size_t row = (size_t) d->ncols * MNT_TEXT_MAX + 1;
+        char *p;
+
+        CHECK((p = parts[t] = malloc(row * (i1 - i0) + 1)) != NULL);
+        for (int i = i0; i < i1; i++)
+        {
+            const float *v = &local[(size_t) (d->up + i) * d->lncols + d->left];
+            len[i] = mnt_format_values(p, v, d->ncols);
+            if (last)
+                p[len[i]++] = '\n';
+            p += len[i];
+        }
+        used[t] = p - parts[t];
+    }
+
+    // tampons des threads dans l'ordre des lignes, par adresse absolue
+    MPI_Aint *addrs;
+    int *sizes;
+    CHECK((addrs = malloc(nt * sizeof(MPI_Aint))) != NULL);
+    CHECK((sizes = malloc(nt * sizeof(int))) != NULL);
+    for (int t = 0; t < nt; t++)
+    {
+        CHECK(used[t] <= INT_MAX);
+        sizes[t] = used[t];
+        MPI_Get_address(parts[t], &addrs[t]);
+    }
+    MPI_Datatype text;
+    MPI_Type_create_hindexed(nt, sizes, addrs, MPI_CHAR, &text);
+    MPI_Type_commit(&text);
+    free(addrs);
+    free(sizes);
+
+    // positions des morceaux
+    MPI_Comm row_comm, col_comm;
+    const int keep_cols[2] = {0, 1}, keep_rows[2] = {1, 0};
+    MPI_Cart_sub(d->comm, keep_cols, &row_comm);
+    MPI_Cart_sub(d->comm, keep_rows, &col_comm);
+
+    MPI_Exscan(len, left, d->nrows, MPI_LONG, MPI_SUM, row_comm);
+    if (d->coords[1] == 0)
+        memset(left, 0, d->nrows * sizeof(long));
+    MPI_Allreduce(len, total, d->nrows, MPI_LONG, MPI_SUM, row_comm);
+
+    long band = 0, before = 0, all = 0;
+    for (int i = 0; i < d->nrows; i++)
+        band += total[i];
+    MPI_Exscan(&band, &before, 1, MPI_LONG, MPI_SUM, col_comm);
+    if (d->coords[0] == 0)
+        before = 0;
+    MPI_Bcast(&header_size, 1, MPI_INT, 0, d->comm);
+    MPI_Allreduce(&band, &all, 1, MPI_LONG, MPI_SUM, col_comm);
+
+    MPI_Aint *displs;
+    int *lengths;
+    CHECK((displs = malloc(d->nrows * sizeof(MPI_Aint))) != NULL);
+    CHECK((lengths = malloc(d->nrows * sizeof(int))) != NULL);
+    MPI_Aint offset = header_size + before;
+    for (int i = 0; i < d->nrows; i++)
+    {
+        displs[i] = offset + left[i];
+        lengths[i] = len[i];
+        offset += total[i];
+    }
+
+    MPI_Datatype t;
+    MPI_Type_create_hindexed(d->nrows, lengths, displs, MPI_CHAR, &t);
+    MPI_Type_commit(&t);
+
+    MPI_File f = create(d, fname, header_size + all, header, header_size);
+    MPI_File_set_view(f, 0, MPI_CHAR, t, "native", MPI_INFO_NULL);
+    CHECK(MPI_File_write_all(f, MPI_BOTTOM, 1, text, MPI_STATUS_IGNORE)
+          == MPI_SUCCESS);
+    MPI_File_close(&f);
+
+    MPI_Type_free(&text);
+    MPI_Type_free(&t);
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+    free(displs);
+    free(lengths);
+    for (int t = 0; t < nt; t++)
+        free(parts[t]);
+    free(parts);
+    free(used);
+    free(len);
+    free(left);
+    free(total);
+}
+
+// seuil de déséquilibre à partir duquel les bandes sont redécoupées : la
+// bande la plus chargée dépasse la moyenne de 10 %
+#define REBALANCE_THRESHOLD 1.1
+
+// nouvelles frontières des bandes de lignes pour la charge load de chaque
+// ligne de la grille : parts de charge égales, chaque frontière restant
+// strictement dans les anciennes bandes voisines (les lignes ne passent que
+// d'un voisin à l'autre) et chaque bande gardant au moins halo lignes.
+// Renvoie 0 si la charge est déjà équilibrée.
+static int new_row_starts(const decomp *d, const long *load, int *starts)
+{
+    const int *old = d->row_starts, np = d->dims[0];
+    long total = 0, max = 0;
+
+    for (int p = 0; p < np; p++)
+    {
+        long band = 0;
+        for (int i = old[p]; i < old[p + 1]; i++)
+            band += load[i];
+        total += band;
+        if (band > max)
+            max = band;
+    }
+    if (total == 0 || max <= REBALANCE_THRESHOLD * total / np)
+        return (0);
+
+    starts[0] = 0;
+    starts[np] = d->gnrows;
+    long cum = 0;
+    int i = 0;
+    for (int p = 1; p < np; p++)
+    {
+        const long target = total * p / np;
+        while (i < d->gnrows && cum + load[i] <= target)
+            cum += load[i++];
+
+        int lo = (starts[p - 1] > old[p - 1] ? starts[p - 1] : old[p - 1])
+                 + d->halo;
+        const int hi = old[p + 1] - d->halo;
+        if (lo > hi)
+            lo = hi;
+        starts[p] = i < lo ? lo : (i > hi ? hi : i);
+    }
+    return (1);
+}
+
+// déplace les lignes possédées de local (bloc lnrows x lncols) vers le bloc
+// des nouvelles bandes starts : les lignes gardées sont recopiées, les autres
+// viennent des voisins nord et sud ou leur sont envoyées
+static float *migrate(const decomp *d, const int *starts, const int lnrows,
+                      float *local)
+{
+    const int p = d->coords[0], n = d->lncols;
+    const int o0 = d->row_starts[p], o1 = d->row_starts[p + 1];
+    const int n0 = starts[p], n1 = starts[p + 1];
+    float *res;
+
+    CHECK((res = malloc((size_t) lnrows * n * sizeof(float))) != NULL);
+    // ligne globale i : ligne i - o0 + up de l'ancien bloc,
+    // i - n0 + up du nouveau
+#define OLD_ROW(i) (&local[(size_t) ((i) - o0 + d->up) * n])
+#define NEW_ROW(i) (&res[(size_t) ((i) - n0 + d->up) * n])
+    const int k0 = o0 > n0 ? o0 : n0, k1 = o1 < n1 ? o1 : n1;
+    if (k0 < k1)
+        memcpy(NEW_ROW(k0), OLD_ROW(k0), (size_t) (k1 - k0) * n * sizeof(float));
+
+    // vers le nord : [o0, n0) partent, [o1, n1) arrivent du sud
+    MPI_Sendrecv(OLD_ROW(o0), n0 > o0 ? (n0 - o0) * n : 0, MPI_FLOAT,
+                 d->neighbours[NORTH], NORTH,
+                 NEW_ROW(o1), n1 > o1 ? (n1 - o1) * n : 0, MPI_FLOAT,
+                 d->neighbours[SOUTH], NORTH, d->comm, MPI_STATUS_IGNORE);
+    // vers le sud : [n1, o1) partent, [n0, o0) arrivent du nord
+    MPI_Sendrecv(OLD_ROW(n1), o1 > n1 ? (o1 - n1) * n : 0, MPI_FLOAT,
+                 d->neighbours[SOUTH], SOUTH,
+                 NEW_ROW(n0), o0 > n0 ? (o0 - n0) * n : 0, MPI_FLOAT,
+                 d->neighbours[NORTH], SOUTH, d->comm, MPI_STATUS_IGNORE);
+#undef OLD_ROW
+#undef NEW_ROW
+
+    free(local);
+    return (res);
+}
+
+// redécoupe les bandes de lignes de la grille de processus suivant la charge
+// load de chaque ligne possédée (d->nrows valeurs, sommées sur chaque ligne
+// de processus) : les frontières se déplacent pour égaliser la charge des
+// bandes, les colonnes ne changent pas. Les narrays tableaux locaux de
+// arrays sont réalloués à la nouvelle taille, lignes possédées déplacées
+// entre voisins et halos échangés. Sans effet (renvoie 0) si la charge est
+// déjà équilibrée ; toutes les décisions sont prises sur des données
+// identiques dans tous les processus.
+int decomp_rebalance(decomp *d, const long *load, float **arrays,
+                     const int narrays)
+{
+    const int np = d->dims[0];
+    if (np == 1)
+        return (0);
+    CHECK(d->node == MPI_COMM_NULL);
+
+    // charge des lignes possédées sur toute la largeur de la grille, puis
+    // de toutes les lignes le long de la colonne de processus
+    MPI_Comm row_comm, col_comm;
+    const int keep_cols[2] = {0, 1}, keep_rows[2] = {1, 0};
+    MPI_Cart_sub(d->comm, keep_cols, &row_comm);
+    MPI_Cart_sub(d->comm, keep_rows, &col_comm);
+
+    long *rows, *all;
+    int *counts, *starts;
+    CHECK((rows = malloc(d->nrows * sizeof(long))) != NULL);
+    CHECK((all = malloc(d->gnrows * sizeof(long))) != NULL);
+    CHECK((counts = malloc(np * sizeof(int))) != NULL);
+    CHECK((starts = malloc((np + 1) * sizeof(int))) != NULL);
+    MPI_Allreduce(load, rows, d->nrows, MPI_LONG, MPI_SUM, row_comm);
+    for (int p = 0; p < np; p++)
+        counts[p] = d->row_starts[p + 1] - d->row_starts[p];
+    MPI_Allgatherv(rows, d->nrows, MPI_LONG, all, counts, d->row_starts,
+                   MPI_LONG, col_comm);
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+
+    const int changed = new_row_starts(d, all, starts);
+    if (changed)
+    {
+        const int nrows = starts[d->coords[0] + 1] - starts[d->coords[0]];
+        const int lnrows = d->up + nrows + d->down;
+        for (int k = 0; k < narrays; k++)
+            arrays[k] = migrate(d, starts, lnrows, arrays[k]);
+
+        memcpy(d->row_starts, starts, (np + 1) * sizeof(int));
+        d->row0 = starts[d->coords[0]];
+        d->nrows = nrows;
+        d->lnrows = lnrows;
+        free_types(d);
+        halo_types(d);
+        for (int k = 0; k < narrays; k++)
+            decomp_exchange(d, arrays[k]);
+    }
+
+    free(rows);
+    free(all);
+    free(counts);
+    free(starts);
+    return (changed);
+}
+
+// envoie/reçoit une zone de halo, sans effet s'il n'y a pas de voisin
+static void sendrecv(const decomp *d, float *W, const int to, const int from)
+{
+    MPI_Sendrecv(W, d->send[to] != MPI_DATATYPE_NULL,
+                 d->send[to] != MPI_DATATYPE_NULL ? d->send[to] : MPI_FLOAT,
+                 d->neighbours[to], to,
+                 W, d->recv[from] != MPI_DATATYPE_NULL,
+                 d->recv[from] != MPI_DATATYPE_NULL ? d->recv[from] : MPI_FLOAT,
+                 d->neighbours[from], DECOMP_NEIGHBOURS - 1 - from,
+                 d->comm, MPI_STATUS_IGNORE);
+}
+
+// bloc partagé de W (0 ou 1, voir decomp_share()), -1 sinon
+static int shared_block(const decomp *d, const float *W)
+{
+    if (d->node == MPI_COMM_NULL)
+        return (-1);
+    return ((W == d->shared[0]) ? 0 : (W == d->shared[1]) ? 1 : -1);
+}
+
+// messages des halos de W (bloc partagé b, -1 : aucun) avec les voisins des
+// autres nœuds : les requêtes sont stockées dans requests, leur nombre est
+// renvoyé
+static int messages_begin(const decomp *d, float *W, const int b,
+                          MPI_Request *requests)
+{
+    int nreq = 0;
+    for (int v = 0; v < DECOMP_NEIGHBOURS; v++)
+    {
+        if (d->neighbours[v] == MPI_PROC_NULL ||
+            (b >= 0 && d->peer[b][v] != NULL))
+            continue;
+        MPI_Irecv(W, 1, d->recv[v], d->neighbours[v],
+                  DECOMP_NEIGHBOURS - 1 - v, d->comm, &requests[nreq++]);
+        MPI_Isend(W, 1, d->send[v], d->neighbours[v], v, d->comm,
+                  &requests[nreq++]);
+    }
+    return (nreq);
+}
+
+// signal vide échangé avec chaque voisin du nœud (bloc partagé b) : ce sont
+// exactement les processus qui lisent notre bloc et dont nous lisons le leur
+static void node_handshake(const decomp *d, const int b, const int tag)
+{
+    MPI_Request requests[2 * DECOMP_NEIGHBOURS];
+    int nreq = 0;
+    for (int v = 0; v < DECOMP_NEIGHBOURS; v++)
+    {
+        if (d->neighbours[v] == MPI_PROC_NULL || d->peer[b][v] == NULL)
+            continue;
+        MPI_Irecv(NULL, 0, MPI_BYTE, d->neighbours[v], tag, d->comm,
+                  &requests[nreq++]);
+        MPI_Isend(NULL, 0, MPI_BYTE, d->neighbours[v], tag, d->comm,
+                  &requests[nreq++]);
+    }
+    MPI_Waitall(nreq, requests, MPI_STATUSES_IGNORE);
+}
+
+// recopie dans les cases fantômes de W (bloc partagé b) les cases des
+// voisins du nœud, coins compris. La synchronisation se fait deux à deux,
+// avec les seuls voisins du nœud : le premier signal attend qu'ils aient
+// fini d'écrire leur bloc b, le second qu'ils aient fini d'y lire nos cases,
+// que nous pouvons ensuite réécrire.
+static void shared_exchange(const decomp *d, float *W, const int b)
+{
+    MPI_Win_sync(d->win);
+    node_handshake(d, b, TAG_WRITTEN);
+    MPI_Win_sync(d->win);
+
+    for (int v = 0; v < DECOMP_NEIGHBOURS; v++)
+    {
+        if (d->neighbours[v] == MPI_PROC_NULL || d->peer[b][v] == NULL)
+            continue;
+        int rr, rs, rn, cr, cs, cn;
+        halo_range(DIRECTIONS[v][0], d->lnrows, d->up, d->down, d->halo,
+                   &rr, &rs, &rn);
+        halo_range(DIRECTIONS[v][1], d->lncols, d->left, d->right, d->halo,
+                   &cr, &cs, &cn);
+        for (int i = 0; i < rn; i++)
+            memcpy(&W[(size_t) (rr + i) * d->lncols + cr],
+                   &d->peer[b][v][(size_t) i * d->peer_ld[v]],
+                   cn * sizeof(float));
+    }
+
+    node_handshake(d, b, TAG_READ);
+}
+
+// échange bloquant des halos de W en deux temps : les colonnes est/ouest des
+// lignes possédées, puis les lignes nord/sud sur toute la largeur locale.
+// Les coins arrivent avec les lignes, qui contiennent déjà les colonnes
+// fantômes reçues au premier temps. Un bloc partagé (decomp_share()) reçoit
+// directement les cases des voisins du nœud, les 8 zones des autres
+// voisins par messages.
+void decomp_exchange(const decomp *d, float *W)
+{
+    const int rows = d->halo * d->lncols;
+    const int b = shared_block(d, W);
+    if (b >= 0)
+    {
+        MPI_Request requests[2 * DECOMP_NEIGHBOURS];
+        const int nreq = messages_begin(d, W, b, requests);
+        shared_exchange(d, W, b);
+        MPI_Waitall(nreq, requests, MPI_STATUSES_IGNORE);
+        return;
+    }
+
+    sendrecv(d, W, WEST, EAST);
+    sendrecv(d, W, EAST, WEST);
+
+    MPI_Sendrecv(&W[d->up * d->lncols], d->up ? rows : 0, MPI_FLOAT,
+                 d->neighbours[NORTH], NORTH,
+                 &W[(d->lnrows - d->down) * d->lncols], d->down ? rows : 0,
+                 MPI_FLOAT, d->neighbours[SOUTH], NORTH,
+                 d->comm, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(&W[(d->lnrows - d->down - d->halo) * d->lncols],
+                 d->down ? rows : 0, MPI_FLOAT, d->neighbours[SOUTH], SOUTH,
+                 &W[0], d->up ? rows : 0,
+                 MPI_FLOAT, d->neighbours[NORTH], SOUTH,
+                 d->comm, MPI_STATUS_IGNORE);
+}
+
+// démarre l'échange non bloquant des halos de W avec les 8 voisins, coins
+// compris : les requêtes sont stockées dans requests (2 * DECOMP_NEIGHBOURS
+// au plus), dont le nombre est renvoyé. Les cases envoyées ne doivent pas
+// être modifiées ni les cases fantômes lues avant MPI_Waitall. Les cases des
+// voisins du nœud d'un bloc partagé sont déjà recopiées au retour.
+int decomp_exchange_begin(const decomp *d, float *W, MPI_Request *requests)
+{
+    const int b = shared_block(d, W);
+    const int nreq = messages_begin(d, W, b, requests);
+    if (b >= 0)
+        shared_exchange(d, W, b);
+    return (nreq);
+}
@@ -0,0 +1,63 @@
+#ifndef __DECOMP_H__
+#define __DECOMP_H__
+
+#include <mpi.h>
+
+// nombre de voisins d'un bloc (même ordre que VOISINS dans darboux.c)
+#define DECOMP_NEIGHBOURS 8
+
+// découpage 2D de la grille en blocs, un bloc par processus d'une grille
+// cartésienne dims[0] x dims[1]. Chaque bloc local contient les cases
+// possédées entourées de halo lignes/colonnes fantômes (aucune sur les bords
+// de la grille complète) :
+//   lignes locales   [0, up) fantômes, [up, lnrows - down) possédées, ...
+//   colonnes locales [0, left) fantômes, [left, lncols - right) possédées, ...
+typedef struct decomp_t
+{
+  MPI_Comm comm;            // cartesian communicator (same ranks as the input)
+  int rank, size;
+  int dims[2], coords[2];   // process grid (rows, cols) and our position
+
+  int gnrows, gncols;       // whole grid size
+  int row0, col0;           // first owned row/col in the whole grid
+  int nrows, ncols;         // owned rows/cols
+  int halo;                 // halo depth
+  int up, down, left, right; // ghost rows/cols on each side (0 or halo)
+  int lnrows, lncols;       // local block size, ghosts included
+  int *row_starts;          // first row of each process row, gnrows at the end
+
+  int neighbours[DECOMP_NEIGHBOURS]; // ranks, MPI_PROC_NULL outside the grid
+
+  // zones de halo échangées avec chaque voisin (MPI_DATATYPE_NULL sans voisin)
+  MPI_Datatype send[DECOMP_NEIGHBOURS], recv[DECOMP_NEIGHBOURS];
+
+  // mémoire partagée entre les processus d'un nœud (voir decomp_share())
+  MPI_Comm node;            // processes of our node, MPI_COMM_NULL if unshared
+  MPI_Win win;              // W and Wprec of every process of the node
+  float *shared[2];         // our two blocks in win
+  // zone envoyée par chaque voisin du nœud dans ses deux blocs (NULL pour un
+  // voisin d'un autre nœud) et largeur de ses lignes
+  const float *peer[2][DECOMP_NEIGHBOURS];
+  int peer_ld[DECOMP_NEIGHBOURS];
+}
+decomp;
+
+int decomp_create(decomp *d, int gnrows, int gncols, int halo, MPI_Comm comm);
+void decomp_free(decomp *d);
+void decomp_share(decomp *d);
+
+void decomp_scatter(const decomp *d, const float *global, float *local);
+void decomp_read(const decomp *d, char *fname, MPI_Offset offset,
+                 float *local);
+void decomp_read_tiled(const decomp *d, char *fname, float *local);
+void decomp_gather(const decomp *d, const float *local, float *global);
+void decomp_write_binary(const decomp *d, char *fname, const void *header,
+                         const float *local);
+void decomp_write_text(const decomp *d, char *fname, const char *header,
+                       int header_size, const float *local);
+
+void decomp_exchange(const decomp *d, float *W);
+int decomp_exchange_begin(const decomp *d, float *W, MPI_Request *requests);
+int decomp_rebalance(decomp *d, const long *load, float **arrays, int narrays);
+
+#endif
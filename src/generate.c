@@ -0,0 +1,131 @@
+// générateur de MNT synthétiques reproductibles pour les tests et les mesures
+// de performance : relief en bruit de valeur sur plusieurs échelles, creusé
+// de cuvettes, avec des plateaux et des trous no_data. La grille ne dépend
+// que de sa taille et de la graine (pas de rand(), pas de libm).
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "type.h"
+#include "generate.h"
+
+// générateur pseudo-aléatoire splitmix64
+static uint64_t next(uint64_t *s)
+{
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31));
+}
+
+// réel uniforme dans [0, 1)
+static float uniform(uint64_t *s)
+{
+    return ((next(s) >> 40) * (1.f / (1 << 24)));
+}
+
+// entier uniforme dans [lo, hi]
+static int between(uint64_t *s, const int lo, const int hi)
+{
+    return (lo + (int) (next(s) % (uint64_t) (hi - lo + 1)));
+}
+
+// valeur pseudo-aléatoire dans [0, 1) attachée au point (i, j) du réseau
+static float lattice(const uint64_t seed, const int i, const int j)
+{
+    uint64_t s = seed ^ ((uint64_t) (uint32_t) i << 32 | (uint32_t) j);
+    next(&s);
+    return (uniform(&s));
+}
+
+// bruit de valeur : interpolation lissée du réseau de pas step
+static float noise(const uint64_t seed, const int i, const int j,
+                   const int step)
+{
+    const int i0 = i / step, j0 = j / step;
+    float x = (float) (i % step) / step, y = (float) (j % step) / step;
+    x = x * x * (3 - 2 * x);
+    y = y * y * (3 - 2 * y);
+
+    const float a = lattice(seed, i0, j0), b = lattice(seed, i0, j0 + 1);
+    const float c = lattice(seed, i0 + 1, j0), d = lattice(seed, i0 + 1, j0 + 1);
+    return ((a * (1 - y) + b * y) * (1 - x) + (c * (1 - y) + d * y) * x);
+}
+
+// nombre d'éléments pour une grille de cells cases, au moins un
+static int features(const long cells, const long per)
+{
+    return (cells / per > 0 ? (int) (cells / per) : 1);
+}
+
+// crée un MNT nrows x ncols à partir de la graine seed
+mnt *mnt_generate(const int nrows, const int ncols, const unsigned long seed)
+{
+    mnt *m;
+    uint64_t s = seed;
+    const long cells = (long) nrows * ncols;
+
+    CHECK(nrows > 0 && ncols > 0);
+    CHECK((m = malloc(sizeof(*m))) != NULL);
+    CHECK((m->terrain = malloc(cells * sizeof(float))) != NULL);
+    m->nrows = nrows;
+    m->ncols = ncols;
+    m->xllcorner = 0;
+    m->yllcorner = 0;
+    m->cellsize = 1;
+    m->no_data = GENERATE_NO_DATA;
+    m->mapping = NULL;
+    m->mapping_size = 0;
+
+    // relief : trois échelles de bruit et une pente douce vers le bord haut
+    const uint64_t s1 = next(&s), s2 = next(&s), s3 = next(&s);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nrows; i++)
+        for (int j = 0; j < ncols; j++)
+            TERRAIN(m, i, j) = 100.f + 60.f * noise(s1, i, j, 97)
+                               + 15.f * noise(s2, i, j, 23)
+                               + 3.f * noise(s3, i, j, 5) + .002f * i;
+
+    // cuvettes : disques creusés en cône
+    for (int k = features(cells, 4000); k > 0; k--)
+    {
+        const int ci = between(&s, 0, nrows - 1), cj = between(&s, 0, ncols - 1);
+        const int r = between(&s, 2, 12);
+        const float depth = 2.f + 18.f * uniform(&s);
+        for (int i = ci - r; i <= ci + r; i++)
+            for (int j = cj - r; j <= cj + r; j++)
+            {
+                const int d2 = (i - ci) * (i - ci) + (j - cj) * (j - cj);
+                if (i >= 0 && i < nrows && j >= 0 && j < ncols && d2 < r * r)
+                    TERRAIN(m, i, j) -= depth * (1.f - (float) d2 / (r * r));
+            }
+    }
+
+    // plateaux : rectangles à la hauteur de leur coin
+    for (int k = features(cells, 20000); k > 0; k--)
+    {
+        const int i0 = between(&s, 0, nrows - 1), j0 = between(&s, 0, ncols - 1);
+        const int i1 = i0 + between(&s, 5, 40), j1 = j0 + between(&s, 5, 40);
+        const float h = TERRAIN(m, i0, j0);
+        for (int i = i0; i < i1 && i < nrows; i++)
+            for (int j = j0; j < j1 && j < ncols; j++)
+                TERRAIN(m, i, j) = h;
+    }
+
+    // trous no_data : disques et cases isolées
+    for (int k = features(cells, 50000); k > 0; k--)
+    {
+        const int ci = between(&s, 0, nrows - 1), cj = between(&s, 0, ncols - 1);
+        const int r = between(&s, 2, 10);
+        for (int i = ci - r; i <= ci + r; i++)
+            for (int j = cj - r; j <= cj + r; j++)
+                if (i >= 0 && i < nrows && j >= 0 && j < ncols &&
+                    (i - ci) * (i - ci) + (j - cj) * (j - cj) < r * r)
+                    TERRAIN(m, i, j) = GENERATE_NO_DATA;
+    }
+    for (int k = features(cells, 1000); k > 0; k--)
+        TERRAIN(m, between(&s, 0, nrows - 1), between(&s, 0, ncols - 1)) =
+            GENERATE_NO_DATA;
+
+    return (m);
+}
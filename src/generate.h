@@ -0,0 +1,11 @@
+#ifndef __GENERATE_H__
+#define __GENERATE_H__
+
+#include "type.h"
+
+// valeur des cases inconnues des MNT générés
+#define GENERATE_NO_DATA -9999.f
+
+mnt *mnt_generate(int nrows, int ncols, unsigned long seed);
+
+#endif
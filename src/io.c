@@ -1,12 +1,232 @@
 // fonctions d'entrée/sortie
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
 
 #include "check.h"
 #include "type.h"
 #include "io.h"
 
+// analyse rapide des fichiers texte : le fichier est projeté en mémoire, les
+// valeurs sont découpées entre les threads OpenMP sur des espaces et
+// converties sans strtof (ni locale) dans le cas courant
+
+static int is_space(const char c)
+{
+  return(c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v'
+         || c == '\f');
+}
+
+// puissances de 10 exactes en float (5^10 < 2^24)
+static const float POW10F[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f,
+                               1e8f, 1e9f, 1e10f};
+#define FAST_MANTISSA (1u << 24)
+#define FAST_EXPONENT 10
+#define TOKEN_MAX 64
+
+// convertit le mot [p, end) en flottant, arrondi comme strtof. Chemin
+// rapide : mantisse sur 24 bits et puissance de 10 exacte, le résultat vient
+// d'une seule opération flottante, donc correctement arrondi. Sinon (mantisse
+// longue, grands exposants, nan, inf...) le mot est confié à strtof.
+static int parse_float(const char *p, const char *end, float *v)
+{
+  const char *s = p;
+  uint64_t mant = 0;
+  int digits = 0, exp10 = 0, any = 0, neg = 0;
+
+  if(s < end && (*s == '-' || *s == '+'))
+    neg = (*s++ == '-');
+  for( ; s < end && *s >= '0' && *s <= '9' ; s++, any = 1)
+  {
+    if(mant == 0 && *s == '0')
+      continue;
+    if(digits++ < 19)
+      mant = mant * 10 + (*s - '0');
+    else
+      exp10++;
+  }
+  if(s < end && *s == '.')
+    for(s++ ; s < end && *s >= '0' && *s <= '9' ; s++, any = 1)
+    {
+      if(mant == 0 && *s == '0')
+      {
+        exp10--;
+        continue;
+      }
+      if(digits++ < 19)
+      {
+        mant = mant * 10 + (*s - '0');
+        exp10--;
+      }
+    }
+  if(any && s < end && (*s == 'e' || *s == 'E'))
+  {
+    const char *e = s + 1;
+    int eneg = 0, ev = 0, edigits = 0;
+    if(e < end && (*e == '-' || *e == '+'))
+      eneg = (*e++ == '-');
+    for( ; e < end && *e >= '0' && *e <= '9' && ev < 10000 ; e++, edigits++)
+      ev = ev * 10 + (*e - '0');
+    if(edigits > 0)
+    {
+      exp10 += eneg ? -ev : ev;
+      s = e;
+    }
+  }
+
+  while(mant != 0 && mant % 10 == 0)
+  {
+    mant /= 10;
+    exp10++;
+  }
+
+  if(any && s == end && digits <= 19 && mant <= FAST_MANTISSA
+     && exp10 >= -FAST_EXPONENT && exp10 <= FAST_EXPONENT)
+  {
+    float f = (float)mant;
+    f = (exp10 < 0) ? f / POW10F[-exp10] : f * POW10F[exp10];
+    *v = neg ? -f : f;
+    return(1);
+  }
+
+  // cas rare : strtof sur une copie terminée par '\0'
+  char token[TOKEN_MAX];
+  char *stop;
+  if(end - p >= TOKEN_MAX)
+    return(0);
+  memcpy(token, p, end - p);
+  token[end - p] = '\0';
+  *v = strtof(token, &stop);
+  return(stop == token + (end - p) && stop != token);
+}
+
+// mot suivant à partir de *p : [*start, *p)
+static int next_token(const char **p, const char *end, const char **start)
+{
+  const char *s = *p;
+  while(s < end && is_space(*s))
+    s++;
+  if(s == end)
+    return(0);
+  *start = s;
+  while(s < end && !is_space(*s))
+    s++;
+  *p = s;
+  return(1);
+}
+
+static float header_float(const char **p, const char *end)
+{
+  const char *t;
+  float v;
+  CHECK(next_token(p, end, &t) && parse_float(t, *p, &v));
+  return(v);
+}
+
+static int header_int(const char **p, const char *end)
+{
+  const char *t;
+  char token[TOKEN_MAX], *stop;
+  CHECK(next_token(p, end, &t) && *p - t < TOKEN_MAX);
+  memcpy(token, t, *p - t);
+  token[*p - t] = '\0';
+  const long v = strtol(token, &stop, 10);
+  CHECK(*stop == '\0');
+  return((int)v);
+}
+
+// début du morceau idx parmi parts de [p, end), recalé après un mot entier
+static const char *chunk(const char *p, const char *end, const int idx,
+                         const int parts)
+{
+  const char *s = p + (end - p) * idx / parts;
+  if(idx == parts)
+    return(end);
+  while(s > p && s < end && !is_space(s[-1]))
+    s++;
+  return(s);
+}
+
 mnt *mnt_read(char *fname)
+{
+  mnt *m;
+  struct stat st;
+  int fd;
+
+  CHECK((m = malloc(sizeof(*m))) != NULL);
+  CHECK((fd = open(fname, O_RDONLY)) >= 0);
+  CHECK(fstat(fd, &st) == 0);
+  CHECK(st.st_size > 0);
+  const char *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  CHECK(text != MAP_FAILED);
+  CHECK(close(fd) == 0);
+
+  const char *p = text, *end = text + st.st_size;
+  m->ncols = header_int(&p, end);
+  m->nrows = header_int(&p, end);
+  m->xllcorner = header_float(&p, end);
+  m->yllcorner = header_float(&p, end);
+  m->cellsize = header_float(&p, end);
+  m->no_data = header_float(&p, end);
+  CHECK(m->ncols > 0 && m->nrows > 0);
+
+  const long n = (long)m->ncols * m->nrows;
+  CHECK((m->terrain = malloc(n * sizeof(float))) != NULL);
+
+  // deux passes par morceau : compter les valeurs, puis les convertir à
+  // leur place (somme préfixe des comptes des morceaux précédents)
+  const int parts = omp_get_max_threads();
+  long *counts, total = 0;
+  int bad = 0;
+  CHECK((counts = calloc(parts + 1, sizeof(long))) != NULL);
+
+  #pragma omp parallel num_threads(parts) reduction(|:bad)
+  {
+    const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+    const char *s = chunk(p, end, t, nt), *e = chunk(p, end, t + 1, nt);
+    const char *tok;
+    long count = 0;
+
+    for(const char *q = s ; next_token(&q, e, &tok) ; )
+      count++;
+    counts[t + 1] = count;
+
+    #pragma omp barrier
+    #pragma omp single
+    {
+      for(int i = 1 ; i <= nt ; i++)
+        counts[i] += counts[i - 1];
+      total = counts[nt];
+    }
+
+    long idx = counts[t];
+    for(const char *q = s ; idx < n && next_token(&q, e, &tok) ; idx++)
+      if(!parse_float(tok, q, &m->terrain[idx]))
+        bad = 1;
+  }
+
+  // comme fscanf, les valeurs en trop sont ignorées
+  CHECK(!bad);
+  CHECK(total >= n);
+
+  free(counts);
+  CHECK(munmap((void *)text, st.st_size) == 0);
+  m->mapping = NULL;
+  m->mapping_size = 0;
+  return(m);
+}
+
+// lecture de référence avec fscanf, lente mais sûre : sert à vérifier
+// mnt_read() (mnt_convert -v)
+mnt *mnt_read_fscanf(char *fname)
 {
   mnt *m;
   FILE *f;
@@ -31,28 +251,745 @@ mnt *mnt_read(char *fname)
   }
 
   CHECK(fclose(f) == 0);
+  m->mapping = NULL;
+  m->mapping_size = 0;
   return(m);
 }
 
-void mnt_write(mnt *m, FILE *f)
+// format binaire : en-tête de MNT_BINARY_HEADER octets puis les
+// ncols * nrows valeurs float32 petit-boutistes, ligne par ligne. La taille
+// de l'en-tête garde les données alignées dans une projection mmap.
+#define MNT_BINARY_MAGIC "MNTB"
+#define MNT_BINARY_VERSION 1
+#define MNT_TILED_MAGIC "MNTZ"     // format tuilé, voir mnt_write_tiled()
+#define MNT_TILED_VERSION 1
+
+typedef struct mnt_header_t
+{
+  char magic[4];
+  uint32_t version;
+  int32_t ncols, nrows;
+  float xllcorner, yllcorner, cellsize, no_data;
+  char padding[MNT_BINARY_HEADER - 32];
+}
+mnt_header;
+
+static int little_endian(void)
+{
+  const uint16_t one = 1;
+  return(*(const uint8_t *)&one == 1);
+}
+
+// inverse l'ordre des octets d'un mot de 32 bits (entier ou flottant)
+static void swap32(void *p)
+{
+  uint8_t *b = p, t;
+  t = b[0]; b[0] = b[3]; b[3] = t;
+  t = b[1]; b[1] = b[2]; b[2] = t;
+}
+
+void mnt_from_little_endian(float *v, const size_t n)
+{
+  if(!little_endian())
+    for(size_t i = 0 ; i < n ; i++)
+      swap32(&v[i]);
+}
+
+// hauteur v en centimètres arrondis au plus proche dans *c, no_data devient
+// MNT_FIXED_NO_DATA ; renvoie 0 hors de [-MNT_FIXED_MAX, MNT_FIXED_MAX]
+static int to_centimetres(const float v, const float no_data, int32_t *c)
 {
+  if(v == no_data)
+  {
+    *c = MNT_FIXED_NO_DATA;
+    return(1);
+  }
+  const double r = rint((double)v * MNT_FIXED_SCALE);
+  if(!(fabs(r) <= MNT_FIXED_MAX))
+    return(0);
+  *c = (int32_t)r;
+  return(1);
+}
+
+// le float le plus proche de la hauteur c en mètres
+static float from_centimetres(const int32_t c, const float no_data)
+{
+  return((c == MNT_FIXED_NO_DATA) ? no_data
+         : (float)((double)c / MNT_FIXED_SCALE));
+}
+
+// mode entier (moteur fixed) : hauteurs en centimètres arrondies au plus
+// proche, no_data devient MNT_FIXED_NO_DATA
+void mnt_to_fixed(int32_t *out, const float *v, const size_t n,
+                  const float no_data)
+{
+#pragma omp parallel for schedule(static)
+  for(size_t i = 0 ; i < n ; i++)
+    CHECK(to_centimetres(v[i], no_data, &out[i]));
+}
+
+// retour aux flottants : le float le plus proche de chaque valeur en mètres
+void mnt_from_fixed(float *out, const int32_t *v, const size_t n,
+                    const float no_data)
+{
+#pragma omp parallel for schedule(static)
+  for(size_t i = 0 ; i < n ; i++)
+    out[i] = from_centimetres(v[i], no_data);
+}
+
+static void header_swap(mnt_header *h)
+{
+  swap32(&h->version);
+  swap32(&h->ncols);
+  swap32(&h->nrows);
+  swap32(&h->xllcorner);
+  swap32(&h->yllcorner);
+  swap32(&h->cellsize);
+  swap32(&h->no_data);
+}
+
+mnt_format mnt_detect(char *fname)
+{
+  char magic[4];
+  FILE *f;
+
+  CHECK((f = fopen(fname, "rb")) != NULL);
+  const size_t n = fread(magic, 1, sizeof(magic), f);
+  CHECK(fclose(f) == 0);
+
+  if(n == sizeof(magic) && memcmp(magic, MNT_BINARY_MAGIC, sizeof(magic)) == 0)
+    return(MNT_BINARY);
+  if(n == sizeof(magic) && memcmp(magic, MNT_TILED_MAGIC, sizeof(magic)) == 0)
+    return(MNT_TILED);
+  return(MNT_ASCII);
+}
+
+// vérifie l'en-tête binaire h d'un fichier de size octets et en remplit m
+static void header_read(mnt_header *h, const size_t size, mnt *m)
+{
+  CHECK(memcmp(h->magic, MNT_BINARY_MAGIC, sizeof(h->magic)) == 0);
+  if(!little_endian())
+    header_swap(h);
+  CHECK(h->version == MNT_BINARY_VERSION);
+  CHECK(h->ncols > 0 && h->nrows > 0);
+  CHECK(size - MNT_BINARY_HEADER >= (size_t)h->ncols * h->nrows * sizeof(float));
+
+  m->ncols = h->ncols;
+  m->nrows = h->nrows;
+  m->xllcorner = h->xllcorner;
+  m->yllcorner = h->yllcorner;
+  m->cellsize = h->cellsize;
+  m->no_data = h->no_data;
+}
+
+// projette le fichier en mémoire : terrain pointe directement dans la
+// projection (copie privée, les écritures ne modifient pas le fichier).
+// Sur une machine gros-boutiste, les valeurs sont converties en place.
+mnt *mnt_read_binary(char *fname)
+{
+  mnt *m;
+  mnt_header h;
+  struct stat st;
+  int fd;
+
+  CHECK((m = malloc(sizeof(*m))) != NULL);
+  CHECK((fd = open(fname, O_RDONLY)) >= 0);
+  CHECK(fstat(fd, &st) == 0);
+  CHECK(st.st_size >= MNT_BINARY_HEADER);
+
+  m->mapping_size = st.st_size;
+  m->mapping = mmap(NULL, m->mapping_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE, fd, 0);
+  CHECK(m->mapping != MAP_FAILED);
+  CHECK(close(fd) == 0);
+
+  memcpy(&h, m->mapping, sizeof(h));
+  header_read(&h, st.st_size, m);
+  m->terrain = (float *)((char *)m->mapping + MNT_BINARY_HEADER);
+
+  mnt_from_little_endian(m->terrain, (size_t)m->ncols * m->nrows);
+
+  // lecture séquentielle de toute la grille
+  madvise(m->mapping, m->mapping_size, MADV_SEQUENTIAL);
+
+  return(m);
+}
+
+// lit seulement l'en-tête d'un fichier binaire : terrain vaut NULL
+mnt *mnt_read_binary_header(char *fname)
+{
+  mnt *m;
+  mnt_header h;
+  struct stat st;
+  FILE *f;
+
+  CHECK((m = malloc(sizeof(*m))) != NULL);
+  CHECK(stat(fname, &st) == 0);
+  CHECK(st.st_size >= MNT_BINARY_HEADER);
+  CHECK((f = fopen(fname, "rb")) != NULL);
+  CHECK(fread(&h, sizeof(h), 1, f) == 1);
+  CHECK(fclose(f) == 0);
+
+  header_read(&h, st.st_size, m);
+  m->terrain = NULL;
+  m->mapping = NULL;
+  m->mapping_size = 0;
+  return(m);
+}
+
+// lit seulement l'en-tête d'un fichier texte, binaire ou tuilé : terrain
+// vaut NULL
+mnt *mnt_read_header(char *fname)
+{
+  mnt *m;
+  FILE *f;
+
+  const mnt_format format = mnt_detect(fname);
+  if(format == MNT_BINARY)
+    return(mnt_read_binary_header(fname));
+  if(format == MNT_TILED)
+    return(mnt_read_tiled_header(fname));
+
+  CHECK((m = malloc(sizeof(*m))) != NULL);
+  CHECK((f = fopen(fname, "r")) != NULL);
+  CHECK(fscanf(f, "%d %d %f %f %f %f", &m->ncols, &m->nrows, &m->xllcorner,
+               &m->yllcorner, &m->cellsize, &m->no_data) == 6);
+  CHECK(fclose(f) == 0);
+  CHECK(m->ncols > 0 && m->nrows > 0);
+  m->terrain = NULL;
+  m->mapping = NULL;
+  m->mapping_size = 0;
+  return(m);
+}
+
+// en-tête binaire de MNT_BINARY_HEADER octets dans buf
+void mnt_binary_header(const mnt *m, void *buf)
+{
+  mnt_header h;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MNT_BINARY_MAGIC, sizeof(h.magic));
+  h.version = MNT_BINARY_VERSION;
+  h.ncols = m->ncols;
+  h.nrows = m->nrows;
+  h.xllcorner = m->xllcorner;
+  h.yllcorner = m->yllcorner;
+  h.cellsize = m->cellsize;
+  h.no_data = m->no_data;
+  if(!little_endian())
+    header_swap(&h);
+  memcpy(buf, &h, sizeof(h));
+}
+
+void mnt_write_binary(mnt *m, FILE *f)
+{
+  char h[MNT_BINARY_HEADER];
+  const size_t n = (size_t)m->ncols * m->nrows;
+
   CHECK(f != NULL);
 
-  fprintf(f, "%d\n", m->ncols);
-  fprintf(f, "%d\n", m->nrows);
-  fprintf(f, "%.2f\n", m->xllcorner);
-  fprintf(f, "%.2f\n", m->yllcorner);
-  fprintf(f, "%.2f\n", m->cellsize);
-  fprintf(f, "%.2f\n", m->no_data);
+  mnt_binary_header(m, h);
+  CHECK(fwrite(h, sizeof(h), 1, f) == 1);
 
-  for(int i = 0 ; i < m->nrows ; i++)
+  if(little_endian())
   {
-    for(int j = 0 ; j < m->ncols ; j++)
+    CHECK(fwrite(m->terrain, sizeof(float), n, f) == n);
+    return;
+  }
+
+  for(size_t i = 0 ; i < n ; i++)
+  {
+    float v = m->terrain[i];
+    swap32(&v);
+    CHECK(fwrite(&v, sizeof(v), 1, f) == 1);
+  }
+}
+
+// format tuilé compressé : en-tête de MNT_BINARY_HEADER octets, index puis
+// tuiles de tile x tile cases (plus petites en bas et à droite), rangées
+// ligne de tuiles par ligne de tuiles. L'index donne la position de chaque
+// tuile dans le fichier (ntiles + 1 entiers de 64 bits petit-boutistes, le
+// dernier étant la taille du fichier) : une fenêtre se lit sans décoder les
+// tuiles qu'elle ne touche pas. Une tuile est un octet de mode puis, case
+// par case, l'écart de son mot de 32 bits à celui de la case de gauche (de
+// la case du dessus en début de ligne), en zigzag puis en varint de 7 bits
+// par octet : les hauteurs voisines, proches, tiennent en 1 ou 2 octets.
+// Le mot est, selon la tuile :
+//  - TILE_CENTIMETRES : la hauteur en centimètres (mnt_to_fixed()), quand
+//    toutes les valeurs s'en déduisent exactement (grilles lues en texte) ;
+//  - TILE_RESIDUAL : de même, suivi de l'écart en bits entre la valeur et le
+//    float des centimètres (quelques ulp pour les résultats, calculés en
+//    float) ;
+//  - TILE_RAW : le motif de bits du float sinon.
+// Sans perte dans tous les cas.
+typedef struct mnt_tiled_header_t
+{
+  char magic[4];
+  uint32_t version;
+  int32_t ncols, nrows;
+  float xllcorner, yllcorner, cellsize, no_data;
+  int32_t tile;
+  char padding[MNT_BINARY_HEADER - 36];
+}
+mnt_tiled_header;
+
+enum { TILE_CENTIMETRES, TILE_RESIDUAL, TILE_RAW };
+
+// octets au plus d'une tuile de n cases : en TILE_RESIDUAL (mode et 2
+// varints de 5 octets par case) suivi de sa version en TILE_RAW
+#define TILE_BOUND(n) (2 + 15 * (size_t)(n))
+
+static void tiled_header_swap(mnt_tiled_header *h)
+{
+  swap32(&h->version);
+  swap32(&h->ncols);
+  swap32(&h->nrows);
+  swap32(&h->xllcorner);
+  swap32(&h->yllcorner);
+  swap32(&h->cellsize);
+  swap32(&h->no_data);
+  swap32(&h->tile);
+}
+
+static int tiles(const int n, const int tile)
+{
+  return((n + tile - 1) / tile);
+}
+
+static uint64_t get64(const uint8_t *p)
+{
+  uint64_t v = 0;
+  for(int k = 7 ; k >= 0 ; k--)
+    v = (v << 8) | p[k];
+  return(v);
+}
+
+static void put64(uint8_t *p, uint64_t v)
+{
+  for(int k = 0 ; k < 8 ; k++, v >>= 8)
+    p[k] = (uint8_t)v;
+}
+
+static uint8_t *put_varint(uint8_t *p, const int32_t d)
+{
+  uint32_t z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31); // zigzag
+  while(z >= 0x80)
+  {
+    *p++ = (uint8_t)(z | 0x80);
+    z >>= 7;
+  }
+  *p++ = (uint8_t)z;
+  return(p);
+}
+
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end,
+                                 int32_t *d)
+{
+  uint32_t z = 0;
+  for(int shift = 0 ; ; shift += 7)
+  {
+    CHECK(p < end && shift < 35);
+    z |= (uint32_t)(*p & 0x7f) << shift;
+    if(*p++ < 0x80)
+      break;
+  }
+  *d = (int32_t)((z >> 1) ^ (0u - (z & 1)));
+  return(p);
+}
+
+static uint32_t float_bits(const float v)
+{
+  uint32_t w;
+  memcpy(&w, &v, sizeof(w));
+  return(w);
+}
+
+// la tuile peut-elle s'écrire en centimètres (TILE_CENTIMETRES, sinon
+// TILE_RESIDUAL) ou seulement en bits (TILE_RAW) ?
+static int tile_mode(const mnt *m, const int i0, const int h, const int j0,
+                     const int w)
+{
+  int mode = TILE_CENTIMETRES;
+  for(int i = i0 ; i < i0 + h ; i++)
+    for(int j = j0 ; j < j0 + w ; j++)
     {
-      fprintf(f, "%.2f ", TERRAIN(m,i,j));
+      const float v = m->terrain[(size_t)i * m->ncols + j];
+      int32_t c;
+      if(!to_centimetres(v, m->no_data, &c))
+        return(TILE_RAW);
+      if(float_bits(v) != float_bits(from_centimetres(c, m->no_data)))
+        mode = TILE_RESIDUAL;
+    }
+  return(mode);
+}
+
+// code dans out la tuile de h x w cases commençant en (i0, j0) dans le mode
+// mode, renvoie sa taille
+static size_t tile_encode_mode(const mnt *m, const int i0, const int h,
+                               const int j0, const int w, const int mode,
+                               uint8_t *out)
+{
+  uint8_t *p = out;
+  *p++ = (uint8_t)mode;
+
+  uint32_t first = 0;
+  for(int i = i0 ; i < i0 + h ; i++)
+  {
+    uint32_t prev = first;
+    for(int j = j0 ; j < j0 + w ; j++)
+    {
+      const float v = m->terrain[(size_t)i * m->ncols + j];
+      uint32_t word = float_bits(v);
+      int32_t c = 0;
+      if(mode != TILE_RAW)
+      {
+        to_centimetres(v, m->no_data, &c);
+        word = (uint32_t)c;
+      }
+
+      p = put_varint(p, (int32_t)(word - prev));
+      if(mode == TILE_RESIDUAL)
+        p = put_varint(p, (int32_t)(float_bits(v) -
+                                    float_bits(from_centimetres(c, m->no_data))));
+      if(j == j0)
+        first = word;
+      prev = word;
     }
-    fprintf(f, "\n");
   }
+  return((size_t)(p - out));
+}
+
+// code la tuile dans out (TILE_BOUND octets) dans le mode le plus compact,
+// renvoie sa taille : des écarts en bits trop grands coûtent plus que les
+// bits eux-mêmes
+static size_t tile_encode(const mnt *m, const int i0, const int h,
+                          const int j0, const int w, uint8_t *out)
+{
+  const int mode = tile_mode(m, i0, h, j0, w);
+  const size_t size = tile_encode_mode(m, i0, h, j0, w, mode, out);
+  if(mode != TILE_RESIDUAL)
+    return(size);
+
+  const size_t raw = tile_encode_mode(m, i0, h, j0, w, TILE_RAW, out + size);
+  if(raw >= size)
+    return(size);
+  memmove(out, out + size, raw);
+  return(raw);
+}
+
+// décode la tuile [p, end) de w cases de large et range ses cases des
+// lignes [r0, r1) et colonnes [c0, c1) de la tuile dans out (lignes de ld
+// valeurs)
+static void tile_decode(const uint8_t *p, const uint8_t *end, const int w,
+                        const int r0, const int r1, const int c0,
+                        const int c1, const float no_data, float *out,
+                        const size_t ld)
+{
+  CHECK(p < end);
+  const int mode = *p++;
+  CHECK(mode == TILE_CENTIMETRES || mode == TILE_RESIDUAL ||
+        mode == TILE_RAW);
+
+  uint32_t first = 0;
+  for(int i = 0 ; i < r1 ; i++)
+  {
+    uint32_t prev = first;
+    for(int j = 0 ; j < w ; j++)
+    {
+      int32_t d, residual = 0;
+      p = get_varint(p, end, &d);
+      if(mode == TILE_RESIDUAL)
+        p = get_varint(p, end, &residual);
+      const uint32_t word = prev + (uint32_t)d;
+      if(j == 0)
+        first = word;
+      prev = word;
+
+      if(i >= r0 && j >= c0 && j < c1)
+      {
+        const uint32_t bits = (mode == TILE_RAW) ? word
+          : float_bits(from_centimetres((int32_t)word, no_data)) +
+            (uint32_t)residual;
+        memcpy(&out[(size_t)(i - r0) * ld + (j - c0)], &bits, sizeof(bits));
+      }
+    }
+  }
+}
+
+// projette le fichier tuilé fname en lecture, en remplit l'en-tête de m et
+// vérifie son index ; renvoie la projection (taille dans *size)
+static const uint8_t *tiled_map(char *fname, mnt *m, int *tile,
+                                size_t *size)
+{
+  mnt_tiled_header h;
+  struct stat st;
+  int fd;
+
+  CHECK((fd = open(fname, O_RDONLY)) >= 0);
+  CHECK(fstat(fd, &st) == 0);
+  CHECK(st.st_size >= MNT_BINARY_HEADER);
+  const uint8_t *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  CHECK(map != MAP_FAILED);
+  CHECK(close(fd) == 0);
+
+  memcpy(&h, map, sizeof(h));
+  CHECK(memcmp(h.magic, MNT_TILED_MAGIC, sizeof(h.magic)) == 0);
+  if(!little_endian())
+    tiled_header_swap(&h);
+  CHECK(h.version == MNT_TILED_VERSION);
+  CHECK(h.ncols > 0 && h.nrows > 0 && h.tile > 0);
+
+  const size_t ntiles = (size_t)tiles(h.nrows, h.tile) * tiles(h.ncols, h.tile);
+  CHECK((size_t)st.st_size >= MNT_BINARY_HEADER + (ntiles + 1) * 8);
+  CHECK(get64(map + MNT_BINARY_HEADER + ntiles * 8) == (uint64_t)st.st_size);
+
+  m->ncols = h.ncols;
+  m->nrows = h.nrows;
+  m->xllcorner = h.xllcorner;
+  m->yllcorner = h.yllcorner;
+  m->cellsize = h.cellsize;
+  m->no_data = h.no_data;
+  m->terrain = NULL;
+  m->mapping = NULL;
+  m->mapping_size = 0;
+  *tile = h.tile;
+  *size = st.st_size;
+  return(map);
+}
+
+// décode la fenêtre de la projection map (grille h) dans out, en parallèle
+// sur les tuiles qu'elle touche
+static void tiled_window(const uint8_t *map, const size_t size, const mnt *h,
+                         const int tile, const int row0, const int nrows,
+                         const int col0, const int ncols, float *out)
+{
+  CHECK(row0 >= 0 && nrows >= 0 && row0 + nrows <= h->nrows);
+  CHECK(col0 >= 0 && ncols >= 0 && col0 + ncols <= h->ncols);
+  if(nrows == 0 || ncols == 0)
+    return;
+
+  const int across = tiles(h->ncols, tile);
+  const int ti0 = row0 / tile, ti1 = (row0 + nrows - 1) / tile;
+  const int tj0 = col0 / tile, tj1 = (col0 + ncols - 1) / tile;
+  const int count = (ti1 - ti0 + 1) * (tj1 - tj0 + 1);
+  const uint8_t *index = map + MNT_BINARY_HEADER;
+
+#pragma omp parallel for schedule(dynamic)
+  for(int k = 0 ; k < count ; k++)
+  {
+    const int ti = ti0 + k / (tj1 - tj0 + 1), tj = tj0 + k % (tj1 - tj0 + 1);
+    const size_t t = (size_t)ti * across + tj;
+    const uint64_t begin = get64(index + t * 8), end = get64(index + t * 8 + 8);
+    CHECK(begin <= end && end <= size);
+
+    // lignes et colonnes de la tuile dans la fenêtre
+    const int i0 = ti * tile, j0 = tj * tile;
+    const int w = (j0 + tile <= h->ncols) ? tile : h->ncols - j0;
+    const int r0 = (row0 > i0) ? row0 - i0 : 0;
+    const int r1 = (row0 + nrows < i0 + tile) ? row0 + nrows - i0 : tile;
+    const int c0 = (col0 > j0) ? col0 - j0 : 0;
+    const int c1 = (col0 + ncols < j0 + w) ? col0 + ncols - j0 : w;
+
+    tile_decode(map + begin, map + end, w, r0, r1, c0, c1, h->no_data,
+                out + (size_t)(i0 + r0 - row0) * ncols + (j0 + c0 - col0),
+                ncols);
+  }
+}
+
+// lit une grille tuilée entière, décodée en parallèle par tuiles
+mnt *mnt_read_tiled(char *fname)
+{
+  mnt *m;
+  int tile;
+  size_t size;
+
+  CHECK((m = malloc(sizeof(*m))) != NULL);
+  const uint8_t *map = tiled_map(fname, m, &tile, &size);
+  CHECK((m->terrain = malloc((size_t)m->ncols * m->nrows * sizeof(float)))
+        != NULL);
+  tiled_window(map, size, m, tile, 0, m->nrows, 0, m->ncols, m->terrain);
+  CHECK(munmap((void *)map, size) == 0);
+  return(m);
+}
+
+// lit seulement l'en-tête d'un fichier tuilé : terrain vaut NULL
+mnt *mnt_read_tiled_header(char *fname)
+{
+  mnt *m;
+  int tile;
+  size_t size;
+
+  CHECK((m = malloc(sizeof(*m))) != NULL);
+  const uint8_t *map = tiled_map(fname, m, &tile, &size);
+  CHECK(munmap((void *)map, size) == 0);
+  return(m);
+}
+
+// lit la fenêtre de nrows x ncols cases commençant en (row0, col0) d'un
+// fichier tuilé dans out (ncols valeurs par ligne) : seules les tuiles
+// touchées sont lues et décodées
+void mnt_read_window(char *fname, const int row0, const int nrows,
+                     const int col0, const int ncols, float *out)
+{
+  mnt h;
+  int tile;
+  size_t size;
+
+  const uint8_t *map = tiled_map(fname, &h, &tile, &size);
+  tiled_window(map, size, &h, tile, row0, nrows, col0, ncols, out);
+  CHECK(munmap((void *)map, size) == 0);
+}
+
+// écrit m au format tuilé : les tuiles sont codées en parallèle, puis
+// écrites dans l'ordre
+void mnt_write_tiled(mnt *m, FILE *f)
+{
+  const int down = tiles(m->nrows, MNT_TILE), across = tiles(m->ncols, MNT_TILE);
+  const int ntiles = down * across;
+  uint8_t **data;
+  size_t *size;
+
+  CHECK(f != NULL);
+  CHECK((data = malloc(ntiles * sizeof(*data))) != NULL);
+  CHECK((size = malloc(ntiles * sizeof(*size))) != NULL);
+
+#pragma omp parallel for schedule(dynamic)
+  for(int t = 0 ; t < ntiles ; t++)
+  {
+    const int i0 = (t / across) * MNT_TILE, j0 = (t % across) * MNT_TILE;
+    const int h = (i0 + MNT_TILE <= m->nrows) ? MNT_TILE : m->nrows - i0;
+    const int w = (j0 + MNT_TILE <= m->ncols) ? MNT_TILE : m->ncols - j0;
+    CHECK((data[t] = malloc(TILE_BOUND(h * w))) != NULL);
+    size[t] = tile_encode(m, i0, h, j0, w, data[t]);
+    CHECK((data[t] = realloc(data[t], size[t])) != NULL);
+  }
+
+  mnt_tiled_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MNT_TILED_MAGIC, sizeof(h.magic));
+  h.version = MNT_TILED_VERSION;
+  h.ncols = m->ncols;
+  h.nrows = m->nrows;
+  h.xllcorner = m->xllcorner;
+  h.yllcorner = m->yllcorner;
+  h.cellsize = m->cellsize;
+  h.no_data = m->no_data;
+  h.tile = MNT_TILE;
+  if(!little_endian())
+    tiled_header_swap(&h);
+  CHECK(fwrite(&h, sizeof(h), 1, f) == 1);
+
+  uint8_t entry[8];
+  uint64_t offset = MNT_BINARY_HEADER + ((uint64_t)ntiles + 1) * 8;
+  for(int t = 0 ; t <= ntiles ; t++)
+  {
+    put64(entry, offset);
+    CHECK(fwrite(entry, sizeof(entry), 1, f) == 1);
+    if(t < ntiles)
+      offset += size[t];
+  }
+  for(int t = 0 ; t < ntiles ; t++)
+  {
+    CHECK(fwrite(data[t], 1, size[t], f) == size[t]);
+    free(data[t]);
+  }
+  free(data);
+  free(size);
+}
+
+// libère les valeurs (projection ou tableau) en gardant l'en-tête
+void mnt_free_terrain(mnt *m)
+{
+  if(m->mapping != NULL)
+    CHECK(munmap(m->mapping, m->mapping_size) == 0);
+  else
+    free(m->terrain);
+  m->mapping = NULL;
+  m->terrain = NULL;
+}
+
+// libère une grille renvoyée par mnt_read(), mnt_read_binary() ou
+// mnt_read_tiled()
+void mnt_free(mnt *m)
+{
+  mnt_free_terrain(m);
+  free(m);
+}
+
+// en-tête texte, tel qu'écrit par mnt_write(), dans buf (taille size)
+int mnt_text_header(const mnt *m, char *buf, const size_t size)
+{
+  const int n = snprintf(buf, size, "%d\n%d\n%.2f\n%.2f\n%.2f\n%.2f\n",
+                         m->ncols, m->nrows, m->xllcorner, m->yllcorner,
+                         m->cellsize, m->no_data);
+  CHECK(n >= 0 && (size_t)n < size);
+  return(n);
+}
+
+// écrit les n valeurs de v comme fprintf(f, "%.2f ") dans buf, qui doit
+// contenir MNT_TEXT_MAX octets par valeur ; renvoie le nombre d'octets.
+// v * 100 est exact en double (24 + 7 bits) : l'arrondi au plus proche, pair
+// en cas d'égalité, donne les mêmes chiffres que printf. Les très grandes
+// valeurs, nan et inf passent par snprintf.
+size_t mnt_format_values(char *buf, const float *v, const int n)
+{
+  char *p = buf;
+
+  for(int k = 0 ; k < n ; k++)
+  {
+    double x = (double)v[k] * 100.;
+    if(x < 0)
+      x = -x;
+    if(!(x < 1e15))
+    {
+      p += snprintf(p, MNT_TEXT_MAX, "%.2f ", v[k]);
+      continue;
+    }
+
+    uint64_t q = (uint64_t)x;
+    const double r = x - (double)q;
+    if(r > .5 || (r == .5 && (q & 1)))
+      q++;
+
+    char digits[24];
+    int nd = 0;
+    uint64_t ip = q / 100;
+    do
+    {
+      digits[nd++] = '0' + ip % 10;
+      ip /= 10;
+    } while(ip != 0);
+
+    if(signbit(v[k]))
+      *p++ = '-';
+    while(nd > 0)
+      *p++ = digits[--nd];
+    *p++ = '.';
+    *p++ = '0' + (q % 100) / 10;
+    *p++ = '0' + q % 10;
+    *p++ = ' ';
+  }
+  return(p - buf);
+}
+
+void mnt_write(mnt *m, FILE *f)
+{
+  char header[MNT_TEXT_HEADER_MAX], *row;
+
+  CHECK(f != NULL);
+  CHECK((row = malloc((size_t)m->ncols * MNT_TEXT_MAX + 1)) != NULL);
+
+  const int n = mnt_text_header(m, header, sizeof(header));
+  CHECK(fwrite(header, 1, n, f) == (size_t)n);
+
+  for(int i = 0 ; i < m->nrows ; i++)
+  {
+    size_t len = mnt_format_values(row, &TERRAIN(m,i,0), m->ncols);
+    row[len++] = '\n';
+    CHECK(fwrite(row, 1, len, f) == len);
+  }
+
+  free(row);
 }
 
 void mnt_write_lakes(mnt *m, mnt *d, FILE *f)
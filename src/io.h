@@ -1,10 +1,60 @@
 #ifndef __IO_H__
 #define __IO_H__
 
+#include <stdio.h>
+#include <stdint.h>
+
 #include "type.h"
 
+// formats de fichier : texte (.mnt), binaire projeté en mémoire (.mntb) ou
+// tuilé compressé (.mntz)
+typedef enum mnt_format_t
+{
+  MNT_ASCII,
+  MNT_BINARY,
+  MNT_TILED
+}
+mnt_format;
+
+// taille de l'en-tête du format binaire, les valeurs suivent
+#define MNT_BINARY_HEADER 64
+
+// côté des tuiles écrites au format tuilé (le même en-tête, puis l'index)
+#define MNT_TILE 256
+
+mnt_format mnt_detect(char *fname);
+
 mnt *mnt_read(char *fname);
+mnt *mnt_read_fscanf(char *fname);
+mnt *mnt_read_binary(char *fname);
+mnt *mnt_read_binary_header(char *fname);
+mnt *mnt_read_tiled(char *fname);
+mnt *mnt_read_tiled_header(char *fname);
+mnt *mnt_read_header(char *fname);
+void mnt_read_window(char *fname, int row0, int nrows, int col0, int ncols,
+                     float *out);
+void mnt_free(mnt *m);
+void mnt_free_terrain(mnt *m);
+void mnt_from_little_endian(float *v, size_t n);
+
+// hauteurs entières du moteur fixed : centimètres, no_data en dessous de tout,
+// MNT_FIXED_MAX laissant la place de max + 10 m et d'EPSILON
+#define MNT_FIXED_SCALE 100
+#define MNT_FIXED_NO_DATA INT32_MIN
+#define MNT_FIXED_MAX (1 << 30)
+void mnt_to_fixed(int32_t *out, const float *v, size_t n, float no_data);
+void mnt_from_fixed(float *out, const int32_t *v, size_t n, float no_data);
+
 void mnt_write(mnt *m, FILE *f);
+void mnt_write_binary(mnt *m, FILE *f);
+void mnt_write_tiled(mnt *m, FILE *f);
+
+// briques des écritures distribuées (decomp_write)
+#define MNT_TEXT_MAX 48          // octets au plus par valeur écrite
+#define MNT_TEXT_HEADER_MAX 256  // octets au plus de l'en-tête texte
+int mnt_text_header(const mnt *m, char *buf, size_t size);
+size_t mnt_format_values(char *buf, const float *v, int n);
+void mnt_binary_header(const mnt *m, void *buf);
 void mnt_write_lakes(mnt *m, mnt *d, FILE *f);
 void mnt_compare(mnt* expected, mnt* result);
 
@@ -0,0 +1,405 @@
+// bibliothèque de remplissage des cuvettes : contexte réutilisable et
+// points d'entrée mnt_fill_block() (blocs déjà répartis) et mnt_fill()
+// (grille entière du processus 0)
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include <omp.h>
+
+#include "check.h"
+#include "type.h"
+#include "darboux.h"
+#include "darboux_flood.h"
+#include "darboux_multigrid.h"
+#include "decomp.h"
+#include "trace.h"
+#include "libmnt.h"
+
+// contexte sur les processus de comm, réglages par défaut de options_parse()
+void mnt_context_init(mnt_context *ctx, MPI_Comm comm)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    MPI_Comm_dup(comm, &ctx->comm);
+    MPI_Comm_rank(ctx->comm, &ctx->rank);
+    MPI_Comm_size(ctx->comm, &ctx->size);
+    ctx->engine = ENGINE_DEFAULT;
+    ctx->halo = 1;
+    ctx->check = 1;
+    workspace_init(&ctx->ws);
+}
+
+// reprend les réglages de calcul de la ligne de commande
+void mnt_context_options(mnt_context *ctx, const options *o)
+{
+    ctx->engine = o->engine;
+    ctx->halo = o->halo;
+    ctx->nonblocking = o->nonblocking;
+    ctx->check = o->check;
+    ctx->rebalance = o->rebalance;
+    ctx->levels = o->levels;
+    ctx->shared = o->shared;
+}
+
+void mnt_context_free(mnt_context *ctx)
+{
+    if (ctx->has_dc)
+        decomp_free(&ctx->dc);
+    workspace_free(&ctx->ws);
+    MPI_Comm_free(&ctx->comm);
+    ctx->has_dc = false;
+}
+
+// rend la mémoire des tampons du contexte, sauf celui du résultat keep
+// (NULL : tous) : pour un seul remplissage, dont le résultat est ensuite
+// écrit
+void mnt_context_trim(mnt_context *ctx, const mnt *keep)
+{
+    workspace_trim(&ctx->ws, (keep != NULL) ? keep->terrain : NULL);
+}
+
+// moteur utilisé : l'inondation a besoin de toute la grille, c'est celui par
+// défaut d'un seul processus, jacobi la remplace sur plusieurs
+engine_t mnt_context_engine(const mnt_context *ctx)
+{
+    if (ctx->engine == ENGINE_DEFAULT || ctx->engine == ENGINE_FLOOD)
+        return ((ctx->size == 1) ? ENGINE_FLOOD : ENGINE_JACOBI);
+    return (ctx->engine);
+}
+
+// découpage en blocs d'une grille de nrows x ncols, gardé d'un remplissage
+// au suivant tant que la taille ne change pas. Seul jacobi calcule sur des
+// halos profonds ; decomp_create() peut réduire leur profondeur. Avec
+// ctx->shared, les blocs de jacobi sont partagés entre les processus d'un
+// même nœud (decomp_share()).
+decomp *mnt_context_decomp(mnt_context *ctx, const int nrows, const int ncols)
+{
+    const bool jacobi = mnt_context_engine(ctx) == ENGINE_JACOBI;
+    const int halo = jacobi ? ctx->halo : 1;
+    const bool shared = jacobi && ctx->shared && ctx->size > 1;
+    if (ctx->has_dc && ctx->dc.gnrows == nrows && ctx->dc.gncols == ncols &&
+        ctx->dc_halo == halo && ctx->dc_shared == shared)
+        return (&ctx->dc);
+
+    if (ctx->has_dc)
+        decomp_free(&ctx->dc);
+    decomp_create(&ctx->dc, nrows, ncols, halo, ctx->comm);
+    if (shared)
+        decomp_share(&ctx->dc);
+    ctx->dc_halo = halo;
+    ctx->dc_shared = shared;
+    ctx->has_dc = true;
+    return (&ctx->dc);
+}
+
+// lance le moteur sur le bloc in, depuis W[0] de ws si guess
+static float *run(mnt_context *ctx, const engine_t engine, mnt *in,
+                  const bool guess)
+{
+    decomp *dc = &ctx->dc;
+
+    if (engine == ENGINE_FLOOD)
+        return (darboux_flood(in, &ctx->ws));
+    if (engine == ENGINE_SWEEP)
+        return (darboux_sweep(in, dc, ctx->check, guess, &ctx->ws));
+    if (engine == ENGINE_FIXED)
+        return (darboux_fixed(in, dc, ctx->check, &ctx->ws));
+    return (darboux(in, dc, ctx->nonblocking, ctx->check, ctx->rebalance,
+                    guess, &ctx->ws));
+}
+
+// départ multigrille du bloc in dans W[0] de ws : estimation calculée par le
+// processus 0 sur la grille entière, whole si known (NULL ailleurs),
+// rassemblée depuis les blocs sinon
+static void multigrid_start(mnt_context *ctx, mnt *in, const mnt *whole,
+                            const bool known)
+{
+    decomp *dc = &ctx->dc;
+    mnt g;
+
+    if (!known && ctx->size == 1)
+        whole = in;
+    else if (!known)
+    {
+        g = *in;
+        g.nrows = dc->gnrows;
+        g.ncols = dc->gncols;
+        g.mapping = NULL;
+        g.terrain = NULL;
+        if (ctx->rank == 0)
+            g.terrain = workspace_get(&ctx->ws, WS_GRID, (size_t) g.nrows *
+                                      g.ncols * sizeof(float));
+        decomp_gather(dc, in->terrain, g.terrain);
+        whole = &g;
+    }
+
+    float *guess = (ctx->rank == 0) ? darboux_multigrid(whole, ctx->levels)
+                                    : NULL;
+    if (ctx->size == 1)
+    {
+        // l'estimation est déjà la grille entière : elle devient W[0]
+        free(ctx->ws.data[WS_W0]);
+        workspace_set(&ctx->ws, WS_W0, guess,
+                      (size_t) in->nrows * in->ncols * sizeof(float));
+        return;
+    }
+    decomp_scatter(dc, guess, workspace_grid(&ctx->ws, WS_W0, in->nrows,
+                                             in->ncols));
+    free(guess);
+}
+
+// remplit le bloc in de ctx->dc, voir multigrid_start() pour whole et known
+static float *fill(mnt_context *ctx, mnt *in, const mnt *whole,
+                   const bool known)
+{
+    const engine_t engine = mnt_context_engine(ctx);
+    if (ctx->threads > 0)
+        omp_set_num_threads(ctx->threads);
+
+    // départ multigrille des moteurs itératifs : un majorant du résultat,
+    // proche de lui
+    const bool guess = ctx->levels > 0 &&
+                       (engine == ENGINE_JACOBI || engine == ENGINE_SWEEP);
+    double t;
+    if (guess)
+    {
+        t = trace_begin();
+        multigrid_start(ctx, in, whole, known);
+        trace_end("multigrid", t, -1);
+    }
+
+    t = trace_begin();
+    float *W = run(ctx, engine, in, guess);
+    trace_end("darboux", t, -1);
+
+    // le départ multigrille repose sur une arithmétique exacte : un
+    // résultat qui n'est pas le point fixe maximal est recalculé depuis
+    // max + 10
+    ctx->restarted = false;
+    if (guess)
+    {
+        t = trace_begin();
+        if (!darboux_verify(in, &ctx->dc, W))
+        {
+            ctx->restarted = true;
+            W = run(ctx, engine, in, false);
+        }
+        trace_end("verify", t, -1);
+    }
+    ctx->iterations = ctx->ws.iterations;
+    return (W);
+}
+
+// plus haute valeur d'un ensemble de cases et nombre de cases qui la portent
+typedef struct peak_t
+{
+    float z;
+    long count;
+}
+peak;
+
+static peak peak_merge(const peak a, const peak b)
+{
+    if (a.count == 0 || (b.count > 0 && b.z > a.z))
+        return (b);
+    if (b.count > 0 && b.z == a.z)
+        return ((peak) {a.z, a.count + b.count});
+    return (a);
+}
+
+// pic des rows x cols valeurs de v, lignes espacées de stride
+static peak peak_box(const float *v, const int stride, const int rows,
+                     const int cols)
+{
+    peak p = {-FLT_MAX, 0};
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            p = peak_merge(p, (peak) {v[(size_t) i * stride + j], 1});
+    return (p);
+}
+
+// pic du terrain de m hors de la boîte [i0, i1) x [j0, j1)
+static peak peak_outside(const mnt *m, const int i0, const int i1,
+                         const int j0, const int j1)
+{
+    const int ncols = m->ncols;
+    peak p = peak_box(m->terrain, ncols, i0, ncols);
+    p = peak_merge(p, peak_box(m->terrain + (size_t) i1 * ncols, ncols,
+                               m->nrows - i1, ncols));
+    for (int i = i0; i < i1; i++)
+    {
+        const float *row = m->terrain + (size_t) i * ncols;
+        p = peak_merge(p, peak_box(row, ncols, 1, j0));
+        p = peak_merge(p, peak_box(row + j1, ncols, 1, ncols - j1));
+    }
+    return (p);
+}
+
+// pic p du terrain dont W est le résultat, gardé pour mnt_refill()
+static void remember_max(mnt_context *ctx, const peak p, const mnt *in,
+                         const float *W)
+{
+    ctx->terrain_max = p.z;
+    ctx->terrain_max_count = p.count;
+    ctx->max_nrows = in->nrows;
+    ctx->max_ncols = in->ncols;
+    ctx->max_result = W;
+    ctx->has_max = true;
+}
+
+// en-tête de in et valeurs W dans out : copiées dans out->terrain s'il est
+// donné, sinon laissées dans le contexte
+static void result(mnt *out, const mnt *in, float *W)
+{
+    float *terrain = out->terrain;
+
+    *out = *in;
+    out->mapping = NULL;
+    out->terrain = W;
+    if (terrain != NULL)
+    {
+        memcpy(terrain, W, (size_t) in->nrows * in->ncols * sizeof(float));
+        out->terrain = terrain;
+    }
+}
+
+// remplit le bloc local in (halos compris) du découpage rendu par
+// mnt_context_decomp(), dans tous les processus du contexte. out reçoit
+// l'en-tête de in et le bloc résultat : dans out->terrain s'il n'est pas
+// NULL (taille du bloc), sinon dans les tampons du contexte, valables
+// jusqu'au remplissage suivant. Avec ctx->rebalance, le bloc in et le
+// découpage peuvent changer de bandes de lignes pendant le calcul.
+void mnt_fill_block(mnt_context *ctx, mnt *in, mnt *out)
+{
+    CHECK(ctx->has_dc);
+    ctx->has_max = false;
+    result(out, in, fill(ctx, in, NULL, false));
+}
+
+// remplit la grille entière in du processus 0 (les autres processus peuvent
+// passer NULL) : répartie en blocs, remplie, puis rassemblée dans out du
+// processus 0, comme dans mnt_fill_block(). Sur un seul processus, la
+// grille est remplie sans copie. Le processus 0 garde le max de in, lié au
+// tableau résultat out->terrain, pour mnt_refill().
+void mnt_fill(mnt_context *ctx, const mnt *in, mnt *out)
+{
+    // en-tête de la grille, du processus 0
+    mnt h;
+    memset(&h, 0, sizeof(h));
+    if (ctx->rank == 0)
+        h = *in;
+    h.mapping = NULL;
+    int sizes[2] = {h.nrows, h.ncols};
+    float values[4] = {h.xllcorner, h.yllcorner, h.cellsize, h.no_data};
+    MPI_Bcast(sizes, 2, MPI_INT, 0, ctx->comm);
+    MPI_Bcast(values, 4, MPI_FLOAT, 0, ctx->comm);
+    h.nrows = sizes[0];
+    h.ncols = sizes[1];
+    h.xllcorner = values[0];
+    h.yllcorner = values[1];
+    h.cellsize = values[2];
+    h.no_data = values[3];
+    ctx->has_max = false;
+    const peak p = (ctx->rank == 0) ? peak_box(in->terrain, h.ncols, h.nrows,
+                                               h.ncols)
+                                    : (peak) {-FLT_MAX, 0};
+
+    decomp *dc = mnt_context_decomp(ctx, h.nrows, h.ncols);
+    mnt block = h;
+    block.nrows = dc->lnrows;
+    block.ncols = dc->lncols;
+    if (ctx->size == 1)
+    {
+        block.terrain = in->terrain;
+        result(out, &block, fill(ctx, &block, in, true));
+        remember_max(ctx, p, &h, out->terrain);
+        return;
+    }
+
+    block.terrain = workspace_grid(&ctx->ws, WS_BLOCK, block.nrows,
+                                   block.ncols);
+    double t = trace_begin();
+    decomp_scatter(dc, (ctx->rank == 0) ? in->terrain : NULL, block.terrain);
+    trace_end("scatter", t, -1);
+
+    float *W = fill(ctx, &block, in, true);
+    // bloc redécoupé par le rééquilibrage : decomp_rebalance() l'a réalloué
+    if (block.terrain != ctx->ws.data[WS_BLOCK])
+        workspace_set(&ctx->ws, WS_BLOCK, block.terrain, (size_t) block.nrows
+                      * block.ncols * sizeof(float));
+
+    t = trace_begin();
+    float *global = NULL;
+    if (ctx->rank == 0)
+        global = (out->terrain != NULL)
+                 ? out->terrain
+                 : workspace_get(&ctx->ws, WS_GRID, (size_t) h.nrows *
+                                 h.ncols * sizeof(float));
+    decomp_gather(dc, W, global);
+    trace_end("gather", t, -1);
+    if (ctx->rank == 0)
+    {
+        *out = h;
+        out->terrain = global;
+        remember_max(ctx, p, &h, global);
+    }
+}
+
+
+// remet à jour W, résultat d'un remplissage de l'ancien terrain, après une
+// modification de in (terrain entier, dans ce processus) limitée à la boîte
+// [i0, i1) x [j0, j1) ; old garde les anciennes valeurs de la boîte, ligne
+// par ligne ((i1 - i0) x (j1 - j0)). Le résultat est celui d'un remplissage
+// complet du nouveau terrain, pour un coût qui suit la zone touchée (voir
+// darboux_refill()). Le max de l'ancien terrain et le nombre de cases qui
+// le portent sont repris du dernier mnt_fill() ou mnt_refill() du contexte
+// dans ce processus si W en est le résultat (même tableau), et mis à jour
+// depuis la boîte seule : le reste du terrain n'est parcouru que si la
+// boîte portait tous les anciens max, ou si W vient d'un autre remplissage. Si le max change, tout est recalculé et ctx->reflooded est levé.
+// Renvoie le nombre de cases recalculées.
+long mnt_refill(mnt_context *ctx, const mnt *in, const float *old, float *W,
+                const int i0, const int i1, const int j0, const int j1)
+{
+    const int ncols = in->ncols, nrows = in->nrows;
+    CHECK(i0 >= 0 && i0 <= i1 && i1 <= nrows && j0 >= 0 && j0 <= j1 &&
+          j1 <= ncols);
+
+    const peak box_old = peak_box(old, j1 - j0, i1 - i0, j1 - j0);
+    const peak box_new = peak_box(in->terrain + (size_t) i0 * ncols + j0,
+                                  ncols, i1 - i0, j1 - j0);
+    peak before, outside;
+    if (ctx->has_max && ctx->max_result == W && ctx->max_nrows == nrows &&
+        ctx->max_ncols == ncols)
+    {
+        // les max de l'ancien terrain hors de la boîte le restent
+        before = (peak) {ctx->terrain_max, ctx->terrain_max_count};
+        outside = before;
+        if (box_old.count > 0 && box_old.z == before.z)
+            outside.count -= box_old.count;
+        if (outside.count <= 0)
+            outside = peak_outside(in, i0, i1, j0, j1);
+    } else
+    {
+        outside = peak_outside(in, i0, i1, j0, j1);
+        before = peak_merge(outside, box_old);
+    }
+    const peak after = peak_merge(outside, box_new);
+
+    double t = trace_begin();
+    long cells;
+    ctx->reflooded = before.z != after.z;
+    if (!ctx->reflooded)
+        cells = darboux_refill(in, W, after.z + 10.f, i0, i1, j0, j1,
+                               &ctx->ws);
+    else
+    {
+        float *full = darboux_flood(in, &ctx->ws);
+        if (full != W)
+            memcpy(W, full, (size_t) nrows * ncols * sizeof(float));
+        cells = (long) nrows * ncols;
+    }
+    trace_end("refill", t, -1);
+    remember_max(ctx, after, in, W);
+    ctx->iterations = ctx->ws.iterations;
+    return (cells);
+}
@@ -0,0 +1,61 @@
+#ifndef __LIBMNT_H__
+#define __LIBMNT_H__
+
+#include <stdbool.h>
+#include <mpi.h>
+
+#include "type.h"
+#include "decomp.h"
+#include "options.h"
+#include "workspace.h"
+
+// bibliothèque de remplissage des cuvettes (libmnt) : un contexte garde le
+// communicateur, le moteur et ses réglages, le découpage de la dernière
+// taille de grille et les tampons de calcul d'un remplissage au suivant.
+// Une fois les tampons à la taille de la plus grande grille vue, un
+// remplissage n'alloue plus rien (hors départ multigrille et rééquilibrage).
+// Plusieurs contextes peuvent coexister, sur des communicateurs différents.
+typedef struct mnt_context_t
+{
+    MPI_Comm comm;        // processes filling together (duplicated)
+    int rank, size;
+    int threads;          // OpenMP threads of a fill, 0 = unchanged
+    engine_t engine;      // see mnt_context_engine()
+    int halo;             // halo depth (jacobi)
+    bool nonblocking;     // overlap the halo exchange (jacobi)
+    int check;            // halo exchanges between convergence tests, 0 = adaptive
+    int rebalance;        // halo exchanges between rebalancings (jacobi), 0 = never
+    int levels;           // multigrid start levels (jacobi, sweep), 0 = max + 10
+    bool shared;          // on-node halos through shared memory (jacobi)
+
+    int iterations;       // iterations of the last fill
+    bool restarted;       // last multigrid start was not an upper bound
+    bool reflooded;       // last refill changed the maximum: full flood
+
+    float terrain_max;    // maximum of the last filled terrain (mnt_refill)
+    long terrain_max_count; // cells holding it
+    int max_nrows, max_ncols; // size of that terrain
+    const float *max_result; // result array of that fill
+    bool has_max;         // known in this process (process 0 of mnt_fill)
+
+    decomp dc;            // blocks of the last grid size
+    bool has_dc;
+    int dc_halo;          // halo depth asked for dc
+    bool dc_shared;       // dc shares the blocks of its node (decomp_share)
+    workspace ws;
+}
+mnt_context;
+
+void mnt_context_init(mnt_context *ctx, MPI_Comm comm);
+void mnt_context_options(mnt_context *ctx, const options *o);
+void mnt_context_free(mnt_context *ctx);
+void mnt_context_trim(mnt_context *ctx, const mnt *keep);
+engine_t mnt_context_engine(const mnt_context *ctx);
+decomp *mnt_context_decomp(mnt_context *ctx, int nrows, int ncols);
+
+void mnt_fill_block(mnt_context *ctx, mnt *in, mnt *out);
+void mnt_fill(mnt_context *ctx, const mnt *in, mnt *out);
+long mnt_refill(mnt_context *ctx, const mnt *in, const float *old, float *W,
+                int i0, int i1, int j0, int j1);
+
+#endif
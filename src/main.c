@@ -4,16 +4,23 @@
 #include <mpi.h>
 #include <omp.h>
 #include <string.h>
+#include <math.h>
 
 #include "type.h"
 #include "io.h"
 #include "darboux.h"
 #include "darboux_seq.h"
+#include "darboux_ooc.h"
+#include "libmnt.h"
+#include "options.h"
+#include "decomp.h"
+#include "trace.h"
+#include "batch.h"
 #include "check.h"
 
 #define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
 
-int rank, size; // External ints
+static int rank, size;
 
 void print_debug(mnt *m, char* prout)
 {
@@ -35,66 +42,103 @@ void print_debug(mnt *m, char* prout)
     }
 }
 
-// inutile de paralleliser ici car trop peu utile
-void calculate_counts(mnt *m, int *rowsPerProc, int *displ)
+int main(int argc, char **argv)
 {
-    for (size_t i = 0; i < size; i++)
-        rowsPerProc[i] = m->nrows / size;
+    mnt *g = NULL, *m, *r; // g: whole grid, only in process 0
+    mnt res = {.terrain = NULL}, *d = &res; // local result, in ctx
+    double time_reference, time_kernel = 0, speedup, efficiency;
+    options o;
+    int format = MNT_ASCII;
 
-    // Check if there is more processes than mat rows
-    if (size > m->nrows)
+    if (options_parse(argc, argv, &o) != 0)
     {
-        for (size_t i = size - m->nrows; i < size; i++)
-            rowsPerProc[i] = 0;
+        options_usage(argv[0]);
+        exit(1);
     }
 
-    // Distribute the remaining rows to the first processes in line
-    int remainingRows = m->nrows % size;
-    for (size_t i = 0; remainingRows > 0; i++, remainingRows--)
-        rowsPerProc[i]++;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (o.trace != NULL)
+        trace_init(MPI_COMM_WORLD);
 
-    // Displacement array
-    int sum = 0;
-    for (size_t i = 0; i < size; i++)
+    // Batch mode: a whole list of grids, see batch.c
+    if (o.batch != NULL)
     {
-        // Elements * cols
-        rowsPerProc[i] *= m->ncols;
-        displ[i] = sum;
-        sum += rowsPerProc[i];
+        batch_run(&o);
+        if (o.trace != NULL)
+            trace_write(o.trace);
+        MPI_Finalize();
+        return (0);
     }
-}
 
-int main(int argc, char **argv)
-{
-    mnt *m, *d, *r, *e = NULL;
-    double time_reference, time_kernel = 0, speedup, efficiency;
-
-    if (argc < 2)
+    // The flood engine needs the whole grid: it is the default on a single
+    // process, the distributed jacobi engine is used otherwise
+    if (o.engine == ENGINE_DEFAULT)
+        o.engine = (size == 1) ? ENGINE_FLOOD : ENGINE_JACOBI;
+    else if (o.engine == ENGINE_FLOOD && size != 1)
     {
-        fprintf(stderr, "Usage: %s <input filename> "
-                        "[<output filename>]\n", argv[0]);
-        exit(1);
+        if (rank == 0)
+            fprintf(stderr, "The flood engine runs on a single process, "
+                            "falling back to jacobi.\n");
+        o.engine = ENGINE_JACOBI;
     }
 
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    // Out-of-core mode: the grid is never loaded as a whole, nor compared
+    // with the reference
+    if (o.budget > 0)
+    {
+        if (size != 1 || mnt_detect(o.input) != MNT_BINARY)
+        {
+            if (rank == 0)
+                fprintf(stderr, "The out-of-core mode runs on a single "
+                                "process with a binary input.\n");
+            MPI_Finalize();
+            return (1);
+        }
+        printf("Starting out-of-core with %d threads (%ld MiB).\n",
+               omp_get_max_threads(), o.budget);
+        time_kernel = omp_get_wtime();
+        darboux_ooc(o.input, o.output, (size_t) o.budget << 20);
+        time_kernel = omp_get_wtime() - time_kernel;
+        printf("Kernel time    : %3.5lf s\n", time_kernel);
+        MPI_Finalize();
+        return (0);
+    }
 
     // READ INPUT ONLY IN PROCESS 0
+    // A binary input is only mapped here: its values are read later by each
+    // process for its own block, the mapping serves the multigrid start and
+    // the verification. Each process also decodes its own tiles of a tiled
+    // input, process 0 only decodes the whole grid when it is needed.
+    double t = trace_begin();
     if (rank == 0)
     {
-        printf("Starting with %d processes with %d threads.\n", size, omp_get_max_threads());
-        m = mnt_read(argv[1]);
-
-        CHECK((e = malloc(sizeof(*e))) != NULL);
-        memcpy(e, m, sizeof(*e));
+        printf("Starting with %d processes with %d threads (%s engine).\n",
+               size, omp_get_max_threads(), options_engine_name(o.engine));
+        format = mnt_detect(o.input);
+        if (format == MNT_BINARY)
+            g = mnt_read_binary(o.input);
+        else if (format == MNT_TILED)
+            g = (size == 1 || o.verify || o.output == NULL)
+                ? mnt_read_tiled(o.input) : mnt_read_tiled_header(o.input);
+        else
+            g = mnt_read(o.input);
 
         time_kernel = omp_get_wtime();
     }
+    MPI_Bcast(&format, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    trace_end("read", t, -1);
+
+    // Local block of each process
+    CHECK((m = malloc(sizeof(*m))) != NULL);
+    if (rank == 0)
+    {
+        memcpy(m, g, sizeof(*m));
+        m->mapping = NULL;
+    }
     else
     {
-        // Malloc new structure
-        CHECK((m = malloc(sizeof(*m))) != NULL);
         m->xllcorner = 0;
         m->yllcorner = 0;
         m->cellsize = 0;
@@ -116,103 +160,217 @@ int main(int argc, char **argv)
     MPI_Type_commit(&mpi_mnt_type);
     MPI_Bcast(m, 1, mpi_mnt_type, 0, MPI_COMM_WORLD);
 
-    // Set result mnt
-    CHECK((r = malloc(sizeof(*r))) != NULL);
-    CHECK((r->terrain = malloc(m->ncols * m->nrows * sizeof(float))) !=NULL);
-    r->nrows = m->nrows;
-    r->ncols = m->ncols;
-    r->xllcorner = m->xllcorner;
-    r->yllcorner = m->yllcorner;
-    r->cellsize = m->cellsize;
-    r->no_data = m->no_data;
-
-    // Init arrays
-    int *rowsPerProc = malloc(size * sizeof(int));
-    int *displ = malloc(size * sizeof(int));
-
-    // Set nrows for each process
-    // effective rows + the one before and after (except on borders)
-    calculate_counts(m, rowsPerProc, displ);
-    m->nrows = (rowsPerProc[rank] / m->ncols);
-    if(size != 1) m->nrows++;
-
-    int startIdx = (rank == 0) ? 0 : m->ncols;
-
-    if (rank != 0)
+    // The whole grid and result are only kept in process 0 for the
+    // verification, the console output and the tiled output (its tiles
+    // straddle the blocks, process 0 encodes them all)
+    r = NULL;
+    const bool gather = o.verify || o.output == NULL || o.tiled;
+
+    // Filling context of the library: engine, settings and buffers
+    mnt_context ctx;
+    mnt_context_init(&ctx, MPI_COMM_WORLD);
+    mnt_context_options(&ctx, &o);
+
+    // 2D blocks on a cartesian process grid. Halo depth: only the jacobi
+    // engine computes on deep halos, and no block may be thinner than it
+    decomp *dc = mnt_context_decomp(&ctx, m->nrows, m->ncols);
+    if (o.engine == ENGINE_JACOBI && dc->halo != o.halo && rank == 0)
+        fprintf(stderr, "Halo depth reduced to %d.\n", dc->halo);
+    if (rank == 0)
+        printf("Process grid: %d x %d.\n", dc->dims[0], dc->dims[1]);
+
+    // Owned cells + the halo ones around them (except on borders)
+    m->nrows = dc->lnrows;
+    m->ncols = dc->lncols;
+    // A single process computes on the whole grid: g and m share it (owned
+    // by m) instead of holding two copies
+    t = trace_begin();
+    if (size == 1 && format != MNT_BINARY)
+        m->terrain = g->terrain;
+    else
     {
-        // Processes in the middle should have 2 rows
-        if (rank != size - 1)
-            m->nrows += 1;
-
-        CHECK((m->terrain = malloc(m->ncols * m->nrows * sizeof(float))) !=
-              NULL);
+        m->terrain = darboux_alloc(m->nrows, m->ncols);
+        if (format == MNT_BINARY)
+        {
+            decomp_read(dc, o.input, MNT_BINARY_HEADER, m->terrain);
+            mnt_from_little_endian(m->terrain, (size_t) m->ncols * m->nrows);
+        }
+        else if (format == MNT_TILED)
+            decomp_read_tiled(dc, o.input, m->terrain);
+        else
+            decomp_scatter(dc, (rank == 0) ? g->terrain : NULL, m->terrain);
+    }
+    if (size == 1 && format == MNT_BINARY)
+    {
+        mnt_free_terrain(g);
+        g->terrain = m->terrain;
+    }
+    trace_end(format != MNT_ASCII ? "read blocks" : "scatter", t, -1);
+
+    // The whole grid is not needed any more without verification nor
+    // console output (a single process shares it with m); the multigrid
+    // start gathers its own copy
+    if (rank == 0 && size != 1 && !gather)
+        mnt_free_terrain(g);
+
+    // COMPUTE, the local result d stays in the buffers of ctx
+    mnt_fill_block(&ctx, m, d);
+    if (ctx.restarted && rank == 0)
+        fprintf(stderr, "The multigrid start was not an upper bound, "
+                        "restarting from max + 10.\n");
+
+    // The fixed engine rounds the terrain to the centimetre: its result is
+    // checked against its own exact equations, not the float reference
+    bool fixed_ok = true;
+    if (o.verify && o.engine == ENGINE_FIXED)
+        fixed_ok = darboux_fixed_verify(m, dc, d->terrain);
+
+    // Only the result is needed from now on, except on a single process
+    // where m also holds the whole grid
+    mnt_context_trim(&ctx, d);
+    if (size != 1)
+    {
+        free(m->terrain);
+        m->terrain = NULL;
+    }
 
-        // Init table terrain with 0
-        #pragma omp parallel for collapse(2)
-        for (int i = 0; i < m->nrows; ++i)
-            for (int j = 0; j < m->ncols; ++j)
-                TERRAIN(m, i, j) = 0;
+    // Result mnt, whole grid only in process 0: on a single process, the
+    // local result itself
+    if (gather)
+    {
+        t = trace_begin();
+        if (rank == 0)
+        {
+            CHECK((r = malloc(sizeof(*r))) != NULL);
+            memcpy(r, g, sizeof(*r));
+            r->mapping = NULL;
+            if (size == 1)
+                r->terrain = d->terrain;
+            else
+                CHECK((r->terrain = malloc((size_t) r->ncols * r->nrows *
+                                           sizeof(float))) != NULL);
+        }
+        if (size != 1)
+            decomp_gather(dc, d->terrain, (rank == 0) ? r->terrain : NULL);
+        trace_end("gather", t, -1);
     }
+    if (rank == 0)
+        time_kernel = omp_get_wtime() - time_kernel ;
 
-    MPI_Scatterv(m->terrain, rowsPerProc, displ,
-                 MPI_FLOAT, &(m->terrain[startIdx]),
-                 rowsPerProc[rank],
-                 MPI_FLOAT, 0, MPI_COMM_WORLD);
+    // WRITE OUTPUT FILE IN PROCESS 0, tiles encoded by its threads
+    if (o.output != NULL && o.tiled)
+    {
+        double time_output = omp_get_wtime();
+        t = trace_begin();
+        if (rank == 0)
+        {
+            FILE *f;
+            CHECK((f = fopen(o.output, "wb")) != NULL);
+            mnt_write_tiled(r, f);
+            CHECK(fclose(f) == 0);
+        }
+        trace_end("write", t, -1);
+        time_output = omp_get_wtime() - time_output;
+        if (rank == 0)
+            printf("Output time    : %3.5lf s\n", time_output);
+    }
 
-    // COMPUTE
-    d = darboux(m);
+    // WRITE OUTPUT FILE IN EVERY PROCESS, each one its own block
+    else if (o.output != NULL)
+    {
+        char header[MNT_TEXT_HEADER_MAX];
+        int header_size = 0;
+        double time_output = omp_get_wtime();
+        t = trace_begin();
+
+        // header of the whole grid, r may not be gathered
+        if (rank == 0 && o.binary)
+            mnt_binary_header(g, header);
+        else if (rank == 0)
+            header_size = mnt_text_header(g, header, sizeof(header));
+
+        if (o.binary)
+            decomp_write_binary(dc, o.output, header, d->terrain);
+        else
+            decomp_write_text(dc, o.output, header, header_size, d->terrain);
 
-    MPI_Gatherv(&(d->terrain[startIdx]),
-                rowsPerProc[rank],
-                MPI_FLOAT, r->terrain,
-                rowsPerProc, displ,
-                MPI_FLOAT, 0, MPI_COMM_WORLD);
+        trace_end("write", t, -1);
+        time_output = omp_get_wtime() - time_output;
+        if (rank == 0)
+            printf("Output time    : %3.5lf s\n", time_output);
+    }
 
-    // WRITE OUTPUT ONLY IN PROCESS 0
+    // WRITE ON THE CONSOLE ONLY IN PROCESS 0
     if (rank == 0)
     {
-        time_kernel = omp_get_wtime() - time_kernel ;
-
         // Value after gather
         // print_debug(r, "R");
 
-        FILE *out;
-        if (argc == 3)
-            out = fopen(argv[2], "w");
-        else
-            out = stdout;
-        mnt_write(r, out);
-        if (argc == 3)
-            fclose(out);
-        else
-            mnt_write_lakes(m, r, stdout);
-
-        // SYNC COMPUTE
-        time_reference = omp_get_wtime();
-        mnt *expected = darboux_seq(e);
-        time_reference  = omp_get_wtime() - time_reference ;
-
-        speedup = time_reference / time_kernel;
-        efficiency = speedup / (omp_get_num_procs() / (1 + HYPERTHREADING));
-        printf("Reference time : %3.5lf s\n", time_reference);
-        printf("Kernel time    : %3.5lf s\n", time_kernel);
-        printf("Speedup ------ : %3.5lf\n", speedup);
-        printf("Efficiency --- : %3.5lf\n", efficiency);
+        if (o.output == NULL)
+        {
+            mnt_write(r, stdout);
+            mnt_write_lakes(g, r, stdout);
+        }
 
-        // Value expected
-        // print_debug(expected, "E");
-        mnt_compare(expected, r);
+        // SYNC COMPUTE, only on request: it takes longer than the kernel
+        if (o.verify)
+        {
+            time_reference = omp_get_wtime();
+            mnt *expected = darboux_seq(g);
+            time_reference  = omp_get_wtime() - time_reference ;
+
+            speedup = time_reference / time_kernel;
+            efficiency = speedup / (omp_get_num_procs() / (1 + HYPERTHREADING));
+            printf("Reference time : %3.5lf s\n", time_reference);
+            printf("Kernel time    : %3.5lf s\n", time_kernel);
+            printf("Iterations     : %d\n", ctx.iterations);
+            printf("Speedup ------ : %3.5lf\n", speedup);
+            printf("Efficiency --- : %3.5lf\n", efficiency);
+
+            // Value expected
+            // print_debug(expected, "E");
+            if (o.engine != ENGINE_FIXED)
+                mnt_compare(expected, r);
+            else
+            {
+                float diff = 0;
+                for (int i = 0; i < r->nrows * r->ncols; i++)
+                    if (fabsf(r->terrain[i] - expected->terrain[i]) > diff)
+                        diff = fabsf(r->terrain[i] - expected->terrain[i]);
+                printf("Rounding diff. : %3.5f\n", diff);
+                fprintf(stderr, fixed_ok ? "Ok results :)\n"
+                                         : "BAD RESULTS ! (not the fixed "
+                                           "point of the rounded terrain)\n");
+            }
+        }
+        else
+        {
+            printf("Kernel time    : %3.5lf s\n", time_kernel);
+            printf("Iterations     : %d\n", ctx.iterations);
+        }
     }
 
+    if (o.trace != NULL)
+        trace_write(o.trace);
+
     // free
-    free(rowsPerProc);
-    free(displ);
+    if (rank == 0)
+    {
+        // shared with m on a single process
+        if (g->terrain == m->terrain)
+            g->terrain = NULL;
+        mnt_free(g);
+    }
     free(m->terrain);
     free(m);
-    free(d->terrain);
-    free(d);
-    free(r->terrain);
-    free(r);
+    if (r != NULL)
+    {
+        // the local result itself on a single process
+        if (r->terrain != d->terrain)
+            free(r->terrain);
+        free(r);
+    }
+    mnt_context_free(&ctx);
 
     // Finalize
     MPI_Finalize();
@@ -0,0 +1,229 @@
+// lecture des options de la ligne de commande
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "options.h"
+
+static const char *ENGINE_NAMES[] = {"default", "jacobi", "flood", "sweep",
+                                     "fixed"};
+
+void options_usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [-e <engine>] [-k <depth>] [-n] [-c <n>] [-r <n>] "
+                  "[-g <levels>] [-H] [-b] [-z]\n"
+                  "          [-m <MiB>] [-v] [-t <trace>]"
+                  " <input filename> [<output filename>]\n"
+                  "       %s -d <output directory> [-s <cells>] [options] "
+                  "<manifest or directory>\n", prog, prog);
+  fprintf(stderr, "  -e <engine>  jacobi | flood | sweep | fixed "
+                  "(default: flood on 1 process, jacobi otherwise)\n"
+                  "               fixed: jacobi on heights rounded to the "
+                  "centimetre, exact integers\n");
+  fprintf(stderr, "  -k <depth>   halo depth of the jacobi engine: ghost rows "
+                  "are exchanged every <depth> iterations (default: 1)\n");
+  fprintf(stderr, "  -n           non-blocking halo exchange overlapped with "
+                  "the interior rows (jacobi)\n");
+  fprintf(stderr, "  -c <n>       test the convergence with a non-blocking "
+                  "reduction every <n> halo exchanges,\n"
+                  "               0 = adaptive interval (default: 1, blocking "
+                  "test at every exchange)\n");
+  fprintf(stderr, "  -r <n>       move the row bands between processes every "
+                  "<n> halo exchanges to\n"
+                  "               balance the remaining work (jacobi, "
+                  "default: 0, never)\n");
+  fprintf(stderr, "  -g <levels>  start from the grid filled at <levels> "
+                  "coarser resolutions instead of\n"
+                  "               max + 10 (jacobi, sweep; default: 0)\n");
+  fprintf(stderr, "  -H           hybrid mode (jacobi): the processes of a node "
+                  "read their halos\n"
+                  "               directly from each other's blocks in shared "
+                  "memory, messages\n"
+                  "               only between nodes\n");
+  fprintf(stderr, "  -b           write the output file in the binary format "
+                  "(the input format is detected)\n");
+  fprintf(stderr, "  -z           write the output file in the tiled "
+                  "compressed format (lossless)\n");
+  fprintf(stderr, "  -m <MiB>     out-of-core mode on a single process: the "
+                  "grid stays on disk and is\n"
+                  "               filled by tiles within this memory budget "
+                  "(binary input and output)\n");
+  fprintf(stderr, "  -v           verify the result against the sequential "
+                  "reference (slow)\n");
+  fprintf(stderr, "  -t <trace>   record the timings of every phase and "
+                  "iteration of each process\n"
+                  "               in this Chrome trace file (chrome://tracing, "
+                  "Perfetto)\n");
+  fprintf(stderr, "  -d <dir>     batch mode: fill every grid listed in the "
+                  "manifest (one filename per\n"
+                  "               line) or found in the directory (*.mnt, "
+                  "*.mntb, *.mntz) into <dir>\n");
+  fprintf(stderr, "  -s <cells>   batch mode: grids of at least <cells> cells "
+                  "are filled by all the\n"
+                  "               processes together, the others by a single "
+                  "process each (default: %ld)\n", OPTIONS_LARGE_DEFAULT);
+}
+
+const char *options_engine_name(engine_t engine)
+{
+  return (ENGINE_NAMES[engine]);
+}
+
+// returns 0 on success, -1 if the command line is invalid
+int options_parse(int argc, char **argv, options *o)
+{
+  int c;
+
+  o->engine = ENGINE_DEFAULT;
+  o->halo = 1;
+  o->nonblocking = false;
+  o->check = 1;
+  o->rebalance = 0;
+  o->levels = 0;
+  o->shared = false;
+  o->binary = false;
+  o->tiled = false;
+  o->budget = 0;
+  o->verify = false;
+  o->trace = NULL;
+  o->batch = NULL;
+  o->large = OPTIONS_LARGE_DEFAULT;
+  o->input = NULL;
+  o->output = NULL;
+
+  while ((c = getopt(argc, argv, "e:k:nc:r:g:Hbzm:vt:d:s:")) != -1)
+  {
+    switch (c)
+    {
+      case 'e':
+        if (strcmp(optarg, "jacobi") == 0)
+          o->engine = ENGINE_JACOBI;
+        else if (strcmp(optarg, "flood") == 0)
+          o->engine = ENGINE_FLOOD;
+        else if (strcmp(optarg, "sweep") == 0)
+          o->engine = ENGINE_SWEEP;
+        else if (strcmp(optarg, "fixed") == 0)
+          o->engine = ENGINE_FIXED;
+        else
+        {
+          fprintf(stderr, "Unknown engine '%s'\n", optarg);
+          return (-1);
+        }
+        break;
+      case 'k':
+        o->halo = atoi(optarg);
+        if (o->halo < 1)
+        {
+          fprintf(stderr, "Invalid halo depth '%s'\n", optarg);
+          return (-1);
+        }
+        break;
+      case 'n':
+        o->nonblocking = true;
+        break;
+      case 'c':
+        o->check = atoi(optarg);
+        if (o->check < 0)
+        {
+          fprintf(stderr, "Invalid convergence interval '%s'\n", optarg);
+          return (-1);
+        }
+        break;
+      case 'r':
+        o->rebalance = atoi(optarg);
+        if (o->rebalance < 0)
+        {
+          fprintf(stderr, "Invalid rebalancing interval '%s'\n", optarg);
+          return (-1);
+        }
+        break;
+      case 'g':
+        o->levels = atoi(optarg);
+        if (o->levels < 0)
+        {
+          fprintf(stderr, "Invalid number of levels '%s'\n", optarg);
+          return (-1);
+        }
+        break;
+      case 'H':
+        o->shared = true;
+        break;
+      case 'b':
+        o->binary = true;
+        break;
+      case 'z':
+        o->tiled = true;
+        break;
+      case 'm':
+        o->budget = atol(optarg);
+        if (o->budget < 1)
+        {
+          fprintf(stderr, "Invalid memory budget '%s'\n", optarg);
+          return (-1);
+        }
+        break;
+      case 'v':
+        o->verify = true;
+        break;
+      case 't':
+        o->trace = optarg;
+        break;
+      case 'd':
+        o->batch = optarg;
+        break;
+      case 's':
+        o->large = atol(optarg);
+        if (o->large < 1)
+        {
+          fprintf(stderr, "Invalid number of cells '%s'\n", optarg);
+          return (-1);
+        }
+        break;
+      default:
+        return (-1);
+    }
+  }
+
+  // positional arguments: <input> [<output>], only <input> in batch mode
+  if (optind >= argc || argc - optind > (o->batch != NULL ? 1 : 2))
+    return (-1);
+  o->input = argv[optind];
+  if (argc - optind == 2)
+    o->output = argv[optind + 1];
+  // the shared blocks of a node keep their size
+  if (o->shared && o->rebalance > 0)
+  {
+    fprintf(stderr, "The hybrid mode does not move the row bands\n");
+    return (-1);
+  }
+  if (o->batch != NULL)
+  {
+    if (o->budget > 0)
+    {
+      fprintf(stderr, "The out-of-core mode fills a single grid\n");
+      return (-1);
+    }
+    return (0);
+  }
+
+  // the binary and tiled outputs are not written on the console
+  if (o->budget > 0)
+  {
+    if (o->tiled)
+    {
+      fprintf(stderr, "The out-of-core mode writes the binary format\n");
+      return (-1);
+    }
+    o->binary = true;
+  }
+  if ((o->binary || o->tiled) && o->output == NULL)
+  {
+    fprintf(stderr, "The %s format needs an output filename\n",
+            o->tiled ? "tiled" : "binary");
+    return (-1);
+  }
+
+  return (0);
+}
@@ -0,0 +1,47 @@
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include <stdbool.h>
+
+// moteurs de calcul disponibles
+typedef enum engine_t
+{
+  ENGINE_DEFAULT, // flood on a single process, jacobi otherwise
+  ENGINE_JACOBI,  // darboux() : itérations de calcul_Wij, distribué MPI
+  ENGINE_FLOOD,   // darboux_flood() : inondation prioritaire, 1 processus
+  ENGINE_SWEEP,   // darboux_sweep() : balayages en place, distribué MPI
+  ENGINE_FIXED    // darboux_fixed() : jacobi en centimètres entiers, distribué
+}
+engine_t;
+
+// mode batch : nombre de cases à partir duquel une grille est distribuée
+#define OPTIONS_LARGE_DEFAULT (4L << 20)
+
+// options de la ligne de commande
+typedef struct options_t
+{
+  engine_t engine;
+  int halo;     // ghost rows exchanged every halo iterations (jacobi)
+  bool nonblocking; // overlap the halo exchange with computation (jacobi)
+  int check;    // halo exchanges between convergence tests, 0 = adaptive
+  int rebalance; // halo exchanges between row band rebalancings, 0 = never
+  int levels;   // coarse levels of the multigrid start, 0 = max + 10
+  bool shared;  // on-node halos through shared memory (jacobi)
+  bool binary;  // write the output in the binary format
+  bool tiled;   // write the output in the tiled compressed format
+  long budget;  // out-of-core mode memory budget in MiB, 0 = in memory
+  bool verify;  // compare the result with darboux_seq()
+  char *trace;  // Chrome trace output filename, NULL = no trace
+  char *batch;  // batch mode output directory, NULL = a single grid
+  long large;   // batch mode: cells from which a grid is distributed
+
+  char *input;  // input filename (batch: manifest or directory)
+  char *output; // output filename, NULL for stdout
+}
+options;
+
+void options_usage(const char *prog);
+int options_parse(int argc, char **argv, options *o);
+const char *options_engine_name(engine_t engine);
+
+#endif
@@ -0,0 +1,143 @@
+// enregistrement des événements de trace et écriture au format Chrome trace :
+// les événements restent en mémoire dans chaque processus et sont rassemblés
+// dans le processus 0 à la fin, qui écrit le fichier JSON
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "trace.h"
+
+#define TRACE_NAME_MAX 16
+
+// un événement, copié tel quel d'un processus à l'autre (MPI_BYTE)
+typedef struct trace_event_t
+{
+    char name[TRACE_NAME_MAX];
+    char phase;     // 'X' : phase de durée dur, 'C' : compteur
+    double ts, dur; // secondes depuis trace_init
+    long value;     // itération ('X', -1 sans), valeur ('C')
+}
+trace_event;
+
+bool trace_enabled = false;
+
+static MPI_Comm trace_comm;
+static double trace_origin;
+static trace_event *events;
+static int nevents, capacity;
+
+// active la trace ; les horloges des processus partent de la même barrière
+void trace_init(MPI_Comm comm)
+{
+    trace_comm = comm;
+    nevents = 0;
+    capacity = 1024;
+    CHECK((events = malloc(capacity * sizeof(*events))) != NULL);
+    MPI_Barrier(comm);
+    trace_origin = MPI_Wtime();
+    trace_enabled = true;
+}
+
+static trace_event *push(const char *name, const char phase)
+{
+    if (nevents == capacity)
+    {
+        capacity *= 2;
+        CHECK((events = realloc(events, capacity * sizeof(*events))) != NULL);
+    }
+    trace_event *e = &events[nevents++];
+    strncpy(e->name, name, TRACE_NAME_MAX - 1);
+    e->name[TRACE_NAME_MAX - 1] = '\0';
+    e->phase = phase;
+    return (e);
+}
+
+void trace_span(const char *name, const double start, const long iteration)
+{
+    const double now = MPI_Wtime();
+    trace_event *e = push(name, 'X');
+    e->ts = start - trace_origin;
+    e->dur = now - start;
+    e->value = iteration;
+}
+
+void trace_counter(const char *name, const double time, const long value)
+{
+    trace_event *e = push(name, 'C');
+    e->ts = time - trace_origin;
+    e->dur = 0;
+    e->value = value;
+}
+
+// rassemble les événements de tous les processus et les écrit dans fname
+// (processus 0) ; désactive la trace
+void trace_write(const char *fname)
+{
+    int rank, size;
+    MPI_Comm_rank(trace_comm, &rank);
+    MPI_Comm_size(trace_comm, &size);
+    trace_enabled = false;
+
+    const int bytes = nevents * sizeof(*events);
+    int *counts = NULL, *displs = NULL, total = 0;
+    trace_event *all = NULL;
+    if (rank == 0)
+    {
+        CHECK((counts = malloc(size * sizeof(int))) != NULL);
+        CHECK((displs = malloc(size * sizeof(int))) != NULL);
+    }
+    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, trace_comm);
+    if (rank == 0)
+    {
+        for (int p = 0; p < size; p++)
+        {
+            displs[p] = total;
+            total += counts[p];
+        }
+        CHECK((all = malloc(total > 0 ? total : 1)) != NULL);
+    }
+    MPI_Gatherv(events, bytes, MPI_BYTE, all, counts, displs, MPI_BYTE, 0,
+                trace_comm);
+
+    if (rank == 0)
+    {
+        FILE *f;
+        CHECK((f = fopen(fname, "w")) != NULL);
+        fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        for (int p = 0; p < size; p++)
+        {
+            fprintf(f, "%s{\"name\": \"process_name\", \"ph\": \"M\", "
+                       "\"pid\": %d, \"args\": {\"name\": \"rank %d\"}}",
+                    p ? ",\n" : "", p, p);
+            const trace_event *e = (const trace_event *) ((char *) all
+                                                          + displs[p]);
+            for (int k = 0; k < counts[p] / (int) sizeof(*e); k++, e++)
+            {
+                // temps en microsecondes
+                if (e->phase == 'C')
+                    fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"C\", "
+                               "\"pid\": %d, \"ts\": %.3f, "
+                               "\"args\": {\"%s\": %ld}}",
+                            e->name, p, e->ts * 1e6, e->name, e->value);
+                else if (e->value >= 0)
+                    fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", "
+                               "\"pid\": %d, \"tid\": 0, \"ts\": %.3f, "
+                               "\"dur\": %.3f, \"args\": {\"iteration\": %ld}}",
+                            e->name, p, e->ts * 1e6, e->dur * 1e6, e->value);
+                else
+                    fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", "
+                               "\"pid\": %d, \"tid\": 0, \"ts\": %.3f, "
+                               "\"dur\": %.3f}",
+                            e->name, p, e->ts * 1e6, e->dur * 1e6);
+            }
+        }
+        fprintf(f, "\n]}\n");
+        CHECK(fclose(f) == 0);
+        free(counts);
+        free(displs);
+        free(all);
+    }
+    free(events);
+    events = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+#include <mpi.h>
+
+// instrumentation à l'exécution : chaque processus enregistre ses phases
+// (lecture, distribution, calcul, halos, réductions, écriture) et le nombre
+// de cases modifiées par itération, le tout écrit au format Chrome trace
+// (chrome://tracing, Perfetto). Désactivée, un événement ne coûte qu'un test.
+// À n'appeler qu'en dehors des régions parallèles.
+extern bool trace_enabled;
+
+void trace_init(MPI_Comm comm);
+void trace_span(const char *name, double start, long iteration);
+void trace_counter(const char *name, double time, long value);
+void trace_write(const char *fname);
+
+// début d'une phase, à passer à trace_end
+static inline double trace_begin(void)
+{
+    return (trace_enabled ? MPI_Wtime() : 0);
+}
+
+// fin d'une phase commencée à start (iteration < 0 : hors des itérations)
+static inline void trace_end(const char *name, const double start,
+                             const long iteration)
+{
+    if (trace_enabled)
+        trace_span(name, start, iteration);
+}
+
+// valeur d'un compteur à l'instant time
+static inline void trace_count(const char *name, const double time,
+                               const long value)
+{
+    if (trace_enabled)
+        trace_counter(name, time, value);
+}
+
+#endif
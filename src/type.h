@@ -2,6 +2,8 @@
 #ifndef __TYPE_H__
 #define __TYPE_H__
 
+#include <stddef.h>
+
 typedef struct mnt_t
 {
   int ncols, nrows;                   // size
@@ -9,6 +11,11 @@ typedef struct mnt_t
   float no_data;                      // mnt value unknown
 
   float *terrain;                     // linear array (size: ncols*nrows)
+
+  // file mapping holding terrain (mnt_read_binary), NULL otherwise ;
+  // released by mnt_free() on the structure returned by the reader only
+  void *mapping;
+  size_t mapping_size;
 }
 mnt;
 
@@ -0,0 +1,86 @@
+// tampons de calcul réutilisés d'un remplissage au suivant
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "check.h"
+#include "workspace.h"
+
+void workspace_init(workspace *ws)
+{
+    memset(ws, 0, sizeof(*ws));
+}
+
+void workspace_free(workspace *ws)
+{
+    for (int k = 0; k < WS_SLOTS; k++)
+        free(ws->data[k]);
+    workspace_init(ws);
+}
+
+// tampon slot d'au moins size octets, au contenu indéfini : l'ancien n'est
+// remplacé que s'il est trop petit
+void *workspace_get(workspace *ws, const workspace_slot slot,
+                    const size_t size)
+{
+    if (size > ws->size[slot])
+    {
+        free(ws->data[slot]);
+        CHECK((ws->data[slot] = malloc(size)) != NULL);
+        ws->size[slot] = size;
+    }
+    return (ws->data[slot]);
+}
+
+// tampon slot d'au moins size octets, au contenu conservé : il double de
+// taille à chaque agrandissement
+void *workspace_grow(workspace *ws, const workspace_slot slot,
+                     const size_t size)
+{
+    if (size > ws->size[slot])
+    {
+        const size_t grown = (2 * ws->size[slot] > size) ? 2 * ws->size[slot]
+                                                          : size;
+        CHECK((ws->data[slot] = realloc(ws->data[slot], grown)) != NULL);
+        ws->size[slot] = grown;
+    }
+    return (ws->data[slot]);
+}
+
+// grille de nrows x ncols flottants (ou entiers 32 bits) : un nouveau tampon
+// est mis à 0 lignes réparties entre les threads comme darboux_alloc()
+// (first touch), un tampon déjà assez grand est rendu tel quel
+float *workspace_grid(workspace *ws, const workspace_slot slot,
+                      const int nrows, const int ncols)
+{
+    const size_t size = (size_t) nrows * ncols * sizeof(float);
+    if (size <= ws->size[slot])
+        return (ws->data[slot]);
+
+    float *restrict a = workspace_get(ws, slot, size);
+#pragma omp parallel for default(none) shared(a, nrows, ncols) schedule(static)
+    for (int i = 0; i < nrows; i++)
+        memset(&a[(size_t) i * ncols], 0, ncols * sizeof(float));
+    return (a);
+}
+
+// remplace le tampon slot par data (size octets), l'ancien ayant déjà été
+// libéré ou réalloué par ailleurs (decomp_rebalance())
+void workspace_set(workspace *ws, const workspace_slot slot, void *data,
+                   const size_t size)
+{
+    ws->data[slot] = data;
+    ws->size[slot] = size;
+}
+
+// libère tous les tampons sauf celui qui commence en keep
+void workspace_trim(workspace *ws, const void *keep)
+{
+    for (int k = 0; k < WS_SLOTS; k++)
+        if (ws->data[k] != keep)
+        {
+            free(ws->data[k]);
+            ws->data[k] = NULL;
+            ws->size[k] = 0;
+        }
+}
@@ -0,0 +1,44 @@
+#ifndef __WORKSPACE_H__
+#define __WORKSPACE_H__
+
+#include <stddef.h>
+
+// tampons de calcul gardés d'un remplissage au suivant (voir libmnt.h) :
+// chaque tampon ne grandit que lorsqu'un calcul en demande plus, une fois à
+// la taille de la plus grande grille vue il n'y a plus d'allocation
+typedef enum workspace_slot_t
+{
+    WS_W0, WS_W1,       // W des moteurs (entiers du moteur fixed), état t % 2
+    WS_FIXED,           // terrain en entiers du moteur fixed, puis son résultat
+    WS_ACTIVE,          // tuiles actives (jacobi, fixed), cases fermées (flood)
+    WS_CHANGED0, WS_CHANGED1, // tuiles modifiées menant à l'état t % 2
+    WS_FINAL,           // masque des cases finales
+    WS_STEPS,           // cases modifiées à chaque étape (jacobi), tas (flood)
+    WS_BLOCK,           // bloc local du terrain (mnt_fill)
+    WS_GRID,            // grille entière, dans le processus 0 (mnt_fill)
+    WS_MARKS,           // marques des cases recalculées (darboux_refill)
+    WS_LIST,            // liste de ces cases (darboux_refill)
+    WS_SLOTS
+}
+workspace_slot;
+
+typedef struct workspace_t
+{
+    void *data[WS_SLOTS];
+    size_t size[WS_SLOTS];    // capacity in bytes
+    int iterations;           // iterations of the last computation
+    unsigned int generation;  // current mark of WS_MARKS
+}
+workspace;
+
+void workspace_init(workspace *ws);
+void workspace_free(workspace *ws);
+void *workspace_get(workspace *ws, workspace_slot slot, size_t size);
+void *workspace_grow(workspace *ws, workspace_slot slot, size_t size);
+float *workspace_grid(workspace *ws, workspace_slot slot, int nrows,
+                      int ncols);
+void workspace_set(workspace *ws, workspace_slot slot, void *data,
+                   size_t size);
+void workspace_trim(workspace *ws, const void *keep);
+
+#endif
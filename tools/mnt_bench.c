@@ -0,0 +1,432 @@
+// banc de mesure des moteurs de calcul : sur un MNT synthétique reproductible
+// (ou un fichier), chaque moteur est lancé pour chaque nombre de threads, avec
+// autant de processus que donnés à mpirun. Les nombres de processus se
+// balaient en relançant le banc (voir make bench), les lignes de résultats
+// s'ajoutant au même fichier CSV ou JSON (un objet par ligne).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mpi.h>
+#include <omp.h>
+
+#include "check.h"
+#include "type.h"
+#include "io.h"
+#include "generate.h"
+#include "darboux.h"
+#include "decomp.h"
+#include "libmnt.h"
+#include "options.h"
+
+// trafic mémoire nominal d'une mise à jour de case : lecture du terrain et
+// de W, écriture de W (les tuiles sautées et les caches ne sont pas comptés)
+#define BYTES_PER_UPDATE (3 * sizeof(float))
+
+#define MAX_RUNS 16
+
+static int rank, size;
+
+typedef struct bench_t
+{
+  int nrows, ncols;
+  unsigned long seed;
+  char *input;                   // NULL: synthetic grid
+  engine_t engines[MAX_RUNS];
+  int nengines;
+  int threads[MAX_RUNS];
+  int nthreads;
+  int repeats;                   // best time kept
+  int json;
+  char *output;                  // NULL: stdout
+  int verify;                    // compare each result with the flood engine
+  int patch;                     // side of the edited box (refill), 0: none
+  int shared;                    // on-node halos through shared memory
+}
+bench;
+
+static void usage(const char *prog)
+{
+  if(rank == 0)
+  {
+    fprintf(stderr, "Usage: mpirun -n <processes> %s [-s <rows>x<cols>] "
+                    "[-S <seed>] [-i <input>]\n"
+                    "          [-e <engines>] [-t <threads>] [-r <repeats>] "
+                    "[-f csv|json] [-o <file>] [-v]\n"
+                    "          [-p <size>] [-H]\n", prog);
+    fprintf(stderr, "  -s  synthetic grid size (default: 2000x2000)\n");
+    fprintf(stderr, "  -S  synthetic grid seed (default: 1)\n");
+    fprintf(stderr, "  -i  bench an existing text, binary or tiled file instead\n");
+    fprintf(stderr, "  -e  comma separated engines (default: jacobi,sweep,"
+                    "flood), also fixed,\n"
+                    "      flood runs on 1 process only\n");
+    fprintf(stderr, "  -t  comma separated thread counts (default: "
+                    "OMP_NUM_THREADS)\n");
+    fprintf(stderr, "  -r  runs of each configuration, the best time is "
+                    "kept (default: 1)\n");
+    fprintf(stderr, "  -f  csv (default) or json, one object per line\n");
+    fprintf(stderr, "  -o  append the results to this file, the CSV header "
+                    "is written when it is empty\n");
+    fprintf(stderr, "  -v  check every result against the flood engine\n");
+    fprintf(stderr, "  -H  hybrid mode of the jacobi engine (shared memory "
+                    "halos on a node)\n");
+    fprintf(stderr, "  -p  also time an incremental refill after editing a "
+                    "centred <size>x<size>\n"
+                    "      box (process 0), checked against a full flood\n");
+  }
+  MPI_Finalize();
+  exit(1);
+}
+
+// liste d'entiers séparés par des virgules, renvoie leur nombre ou -1
+static int parse_threads(char *s, int *list)
+{
+  int n = 0;
+  for(char *tok = strtok(s, ","); tok != NULL; tok = strtok(NULL, ","))
+  {
+    if(n == MAX_RUNS || (list[n] = atoi(tok)) < 1)
+      return(-1);
+    n++;
+  }
+  return(n);
+}
+
+static int parse_engines(char *s, engine_t *list)
+{
+  int n = 0;
+  for(char *tok = strtok(s, ","); tok != NULL; tok = strtok(NULL, ","))
+  {
+    if(n == MAX_RUNS)
+      return(-1);
+    if(strcmp(tok, "jacobi") == 0)
+      list[n++] = ENGINE_JACOBI;
+    else if(strcmp(tok, "sweep") == 0)
+      list[n++] = ENGINE_SWEEP;
+    else if(strcmp(tok, "flood") == 0)
+      list[n++] = ENGINE_FLOOD;
+    else if(strcmp(tok, "fixed") == 0)
+      list[n++] = ENGINE_FIXED;
+    else
+      return(-1);
+  }
+  return(n);
+}
+
+static void bench_parse(int argc, char **argv, bench *b)
+{
+  int c;
+
+  b->nrows = b->ncols = 2000;
+  b->seed = 1;
+  b->input = NULL;
+  b->engines[0] = ENGINE_JACOBI;
+  b->engines[1] = ENGINE_SWEEP;
+  b->engines[2] = ENGINE_FLOOD;
+  b->nengines = 3;
+  b->threads[0] = omp_get_max_threads();
+  b->nthreads = 1;
+  b->repeats = 1;
+  b->json = 0;
+  b->output = NULL;
+  b->verify = 0;
+  b->patch = 0;
+  b->shared = 0;
+
+  while((c = getopt(argc, argv, "s:S:i:e:t:r:f:o:vp:H")) != -1)
+  {
+    switch(c)
+    {
+      case 's':
+        if(sscanf(optarg, "%dx%d", &b->nrows, &b->ncols) != 2 ||
+           b->nrows < 1 || b->ncols < 1)
+          usage(argv[0]);
+        break;
+      case 'S':
+        b->seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'i':
+        b->input = optarg;
+        break;
+      case 'e':
+        if((b->nengines = parse_engines(optarg, b->engines)) < 1)
+          usage(argv[0]);
+        break;
+      case 't':
+        if((b->nthreads = parse_threads(optarg, b->threads)) < 1)
+          usage(argv[0]);
+        break;
+      case 'r':
+        if((b->repeats = atoi(optarg)) < 1)
+          usage(argv[0]);
+        break;
+      case 'f':
+        if(strcmp(optarg, "json") == 0)
+          b->json = 1;
+        else if(strcmp(optarg, "csv") != 0)
+          usage(argv[0]);
+        break;
+      case 'o':
+        b->output = optarg;
+        break;
+      case 'v':
+        b->verify = 1;
+        break;
+      case 'H':
+        b->shared = 1;
+        break;
+      case 'p':
+        if((b->patch = atoi(optarg)) < 1)
+          usage(argv[0]);
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind != argc)
+    usage(argv[0]);
+}
+
+// lance le moteur du contexte sur le bloc local, renvoie le temps le plus
+// court : les tampons du contexte ne sont alloués qu'à la première fois
+static double run(const bench *b, mnt_context *ctx, const mnt *m,
+                  const float *global, mnt *result)
+{
+  const decomp *dc = &ctx->dc;
+  double best = 0;
+  mnt local = *m;
+  local.terrain = darboux_alloc(dc->lnrows, dc->lncols);
+
+  for(int k = 0; k < b->repeats; k++)
+  {
+    decomp_scatter(dc, global, local.terrain);
+    result->terrain = NULL;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t = MPI_Wtime();
+    mnt_fill_block(ctx, &local, result);
+    MPI_Barrier(MPI_COMM_WORLD);
+    t = MPI_Wtime() - t;
+
+    if(k == 0 || t < best)
+      best = t;
+  }
+  free(local.terrain);
+  return(best);
+}
+
+// ajoute une ligne de résultats (processus 0)
+// cells : cases mises à jour par itération
+static void report(FILE *f, const bench *b, const char *engine, int threads,
+                   const mnt *g, double cells, int iterations, double time,
+                   const char *verified)
+{
+  const double updates = cells * iterations;
+  const double gbs = updates * BYTES_PER_UPDATE / time / 1e9;
+
+  if(b->json)
+    fprintf(f, "{\"engine\": \"%s\", \"processes\": %d, \"threads\": %d, "
+               "\"rows\": %d, \"cols\": %d, \"iterations\": %d, "
+               "\"seconds\": %.6f, \"cells_per_s\": %.4e, "
+               "\"updates_per_s\": %.4e, \"gb_per_s\": %.3f, "
+               "\"verified\": \"%s\"}\n",
+            engine, size, threads, g->nrows, g->ncols,
+            iterations, time, cells / time, updates / time, gbs,
+            verified);
+  else
+    fprintf(f, "%s,%d,%d,%d,%d,%d,%.6f,%.4e,%.4e,%.3f,%s\n",
+            engine, size, threads, g->nrows, g->ncols,
+            iterations, time, cells / time, updates / time, gbs,
+            verified);
+  fflush(f);
+}
+
+// remplissage incrémental (processus 0) : une boîte centrée de la grille est
+// modifiée, digue de +5 m sur sa moitié haute et tranchée de -3 m sur sa
+// moitié basse, puis le remplissage de départ est remis à jour par
+// mnt_refill() et comparé à un remplissage complet de la grille modifiée.
+// Le remplissage de départ est refait, hors mesure, avant chaque essai : il
+// donne aussi au contexte le max de l'ancien terrain. Si la digue élève le
+// max, mnt_refill() a tout recalculé : la ligne devient refill-full.
+// La vérification reprend aussi la suite d'un service de tuiles : grille g
+// remplie, puis une autre grille de même taille (g plus 40 m), puis
+// remplissage incrémental de celui de g, qui ne doit pas reprendre le max de
+// l'autre grille. La boîte y est entourée d'un anneau de no_data : ses cases
+// ne sont reliées à aucun bord et gardent ce max.
+static void refill(FILE *f, const bench *b, mnt_context *seq, const mnt *g)
+{
+  const size_t cells = (size_t) g->nrows * g->ncols;
+  const int h = (b->patch < g->nrows) ? b->patch : g->nrows;
+  const int w = (b->patch < g->ncols) ? b->patch : g->ncols;
+  const int i0 = (g->nrows - h) / 2, j0 = (g->ncols - w) / 2;
+  mnt p = *g, start, full;
+  float *old;
+  long touched = 0;
+
+  CHECK((p.terrain = malloc(cells * sizeof(float))) != NULL);
+  CHECK((start.terrain = malloc(cells * sizeof(float))) != NULL);
+  CHECK((full.terrain = malloc(cells * sizeof(float))) != NULL);
+  CHECK((old = malloc((size_t) h * w * sizeof(float))) != NULL);
+  memcpy(p.terrain, g->terrain, cells * sizeof(float));
+
+  for(int i = i0; i < i0 + h; i++)
+    for(int j = j0; j < j0 + w; j++)
+    {
+      float *z = &p.terrain[(size_t) i * p.ncols + j];
+      old[(i - i0) * w + j - j0] = *z;
+      if(*z != p.no_data)
+        *z += (i < i0 + h / 2) ? 5.f : -3.f;
+    }
+
+  double best = 0;
+  for(int k = 0; k < b->repeats; k++)
+  {
+    mnt_fill(seq, g, &start);
+    double t = MPI_Wtime();
+    touched = mnt_refill(seq, &p, old, start.terrain, i0, i0 + h, j0, j0 + w);
+    t = MPI_Wtime() - t;
+    if(k == 0 || t < best)
+      best = t;
+  }
+
+  const bool reflooded = seq->reflooded;
+  mnt_fill(seq, &p, &full);
+  bool ok = memcmp(start.terrain, full.terrain, cells * sizeof(float)) == 0;
+
+  mnt a = *g, q = *g, other;
+  CHECK((a.terrain = malloc(cells * sizeof(float))) != NULL);
+  CHECK((q.terrain = malloc(cells * sizeof(float))) != NULL);
+  CHECK((other.terrain = malloc(cells * sizeof(float))) != NULL);
+  memcpy(a.terrain, g->terrain, cells * sizeof(float));
+  for(size_t k = 0; k < cells; k++)
+    q.terrain[k] = (g->terrain[k] != g->no_data) ? g->terrain[k] + 40.f
+                                                 : g->no_data;
+  for(int i = i0 - 1; i <= i0 + h; i++)
+    for(int j = j0 - 1; j <= j0 + w; j++)
+      if(i >= 0 && i < g->nrows && j >= 0 && j < g->ncols &&
+         (i < i0 || i >= i0 + h || j < j0 || j >= j0 + w))
+        a.terrain[(size_t) i * g->ncols + j] =
+          p.terrain[(size_t) i * g->ncols + j] = g->no_data;
+  mnt_fill(seq, &p, &full);
+  mnt_fill(seq, &a, &start);
+  mnt_fill(seq, &q, &other);
+  mnt_refill(seq, &p, old, start.terrain, i0, i0 + h, j0, j0 + w);
+  ok = ok && memcmp(start.terrain, full.terrain, cells * sizeof(float)) == 0;
+
+  report(f, b, reflooded ? "refill-full" : "refill", omp_get_max_threads(),
+         g, (double) touched, 1, best, ok ? "ok" : "BAD");
+  free(other.terrain);
+  free(q.terrain);
+  free(a.terrain);
+  free(old);
+  free(full.terrain);
+  free(start.terrain);
+  free(p.terrain);
+}
+
+int main(int argc, char **argv)
+{
+  bench b;
+  mnt *g = NULL, expected = {.terrain = NULL}, m;
+  mnt_context ctx, seq;
+  FILE *f = NULL;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  bench_parse(argc, argv, &b);
+  memset(&m, 0, sizeof(m));
+
+  // grille complète dans le processus 0 seulement
+  if(rank == 0)
+  {
+    if(b.input == NULL)
+      g = mnt_generate(b.nrows, b.ncols, b.seed);
+    else if(mnt_detect(b.input) == MNT_BINARY)
+      g = mnt_read_binary(b.input);
+    else if(mnt_detect(b.input) == MNT_TILED)
+      g = mnt_read_tiled(b.input);
+    else
+      g = mnt_read(b.input);
+    m = *g;
+    // référence : inondation dans son propre contexte, gardé jusqu'à la fin
+    mnt_context_init(&seq, MPI_COMM_SELF);
+    seq.engine = ENGINE_FLOOD;
+    if(b.verify)
+      mnt_fill(&seq, g, &expected);
+
+    if(b.output == NULL)
+      f = stdout;
+    else
+      CHECK((f = fopen(b.output, "a")) != NULL);
+    if(!b.json && ftell(f) <= 0)
+      fprintf(f, "engine,processes,threads,rows,cols,iterations,seconds,"
+                 "cells_per_s,updates_per_s,gb_per_s,verified\n");
+  }
+  MPI_Bcast(&m.nrows, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&m.ncols, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&m.no_data, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+  m.mapping = NULL;
+
+  mnt_context_init(&ctx, MPI_COMM_WORLD);
+  ctx.shared = b.shared;
+
+  float *result = NULL;
+  if(rank == 0 && b.verify)
+    CHECK((result = malloc((size_t) m.nrows * m.ncols * sizeof(float)))
+          != NULL);
+
+  for(int e = 0; e < b.nengines; e++)
+  {
+    // l'inondation a besoin de toute la grille
+    if(b.engines[e] == ENGINE_FLOOD && size != 1)
+      continue;
+    ctx.engine = b.engines[e];
+    const decomp *dc = mnt_context_decomp(&ctx, m.nrows, m.ncols);
+    mnt local = m;
+    local.nrows = dc->lnrows;
+    local.ncols = dc->lncols;
+
+    for(int t = 0; t < b.nthreads; t++)
+    {
+      mnt d;
+      omp_set_num_threads(b.threads[t]);
+      const double time = run(&b, &ctx, &local,
+                              (rank == 0) ? g->terrain : NULL, &d);
+
+      const char *verified = "-";
+      if(b.verify && b.engines[e] == ENGINE_FIXED)
+      {
+        // terrain arrondi au centimètre : vérifié sur ses propres équations
+        mnt z = local;
+        z.terrain = darboux_alloc(dc->lnrows, dc->lncols);
+        decomp_scatter(dc, (rank == 0) ? g->terrain : NULL, z.terrain);
+        verified = darboux_fixed_verify(&z, dc, d.terrain) ? "ok" : "BAD";
+        free(z.terrain);
+      }
+      else if(b.verify)
+      {
+        decomp_gather(dc, d.terrain, result);
+        if(rank == 0)
+          verified = memcmp(result, expected.terrain, (size_t) m.nrows *
+                            m.ncols * sizeof(float)) == 0 ? "ok" : "BAD";
+      }
+      if(rank == 0)
+        report(f, &b, options_engine_name(b.engines[e]), b.threads[t], g,
+               (double) m.nrows * m.ncols, ctx.iterations, time, verified);
+    }
+  }
+
+  mnt_context_free(&ctx);
+  if(rank == 0)
+  {
+    if(b.patch > 0)
+      refill(f, &b, &seq, g);
+    if(f != stdout)
+      CHECK(fclose(f) == 0);
+    mnt_context_free(&seq);
+    free(result);
+    mnt_free(g);
+  }
+  MPI_Finalize();
+  return(0);
+}
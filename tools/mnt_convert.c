@@ -0,0 +1,93 @@
+// convertisseur entre le format texte (.mnt) et le format binaire du MNT :
+// le format de l'entrée est détecté, la sortie est écrite dans l'autre (en
+// binaire pour une entrée tuilée). Avec -z, la sortie est au format tuilé
+// compressé. Avec -v, vérifie l'analyse parallèle d'un fichier texte contre
+// fscanf.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "check.h"
+#include "type.h"
+#include "io.h"
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [-z] <input filename> <output filename>\n",
+          prog);
+  fprintf(stderr, "       %s -v <text input filename>\n", prog);
+  fprintf(stderr, "  text input -> binary output, binary input -> text "
+                  "output (values rounded to 2 decimals),\n"
+                  "  tiled input -> binary output\n");
+  fprintf(stderr, "  -z  write the tiled compressed format, lossless, "
+                  "whatever the input\n");
+  fprintf(stderr, "  -v  compare the parallel text parser with fscanf\n");
+  exit(1);
+}
+
+// lit le fichier texte avec les deux analyseurs et compare les grilles
+static int verify(char *fname)
+{
+  CHECK(mnt_detect(fname) == MNT_ASCII);
+
+  double t = omp_get_wtime();
+  mnt *expected = mnt_read_fscanf(fname);
+  const double time_fscanf = omp_get_wtime() - t;
+
+  t = omp_get_wtime();
+  mnt *m = mnt_read(fname);
+  const double time_parallel = omp_get_wtime() - t;
+
+  printf("fscanf   : %3.5lf s\n", time_fscanf);
+  printf("parallel : %3.5lf s (%d threads)\n", time_parallel,
+         omp_get_max_threads());
+  mnt_compare(expected, m);
+
+  // mnt_compare compare les valeurs avec !=, ici les bits comptent aussi
+  const int same = memcmp(expected->terrain, m->terrain,
+                          (size_t)m->ncols * m->nrows * sizeof(float)) == 0;
+  mnt_free(expected);
+  mnt_free(m);
+  return(same ? 0 : 1);
+}
+
+static const char *format_name(const mnt_format format)
+{
+  return(format == MNT_BINARY ? "binary"
+         : format == MNT_TILED ? "tiled" : "text");
+}
+
+int main(int argc, char **argv)
+{
+  if(argc == 3 && strcmp(argv[1], "-v") == 0)
+    return(verify(argv[2]));
+  const int tiled = argc == 4 && strcmp(argv[1], "-z") == 0;
+  if(argc != 3 && !tiled)
+    usage(argv[0]);
+  char *input = argv[argc - 2], *output = argv[argc - 1];
+
+  const mnt_format format = mnt_detect(input);
+  mnt *m = (format == MNT_BINARY) ? mnt_read_binary(input)
+           : (format == MNT_TILED) ? mnt_read_tiled(input)
+           : mnt_read(input);
+  const mnt_format to = tiled ? MNT_TILED
+                        : (format == MNT_ASCII || format == MNT_TILED)
+                        ? MNT_BINARY : MNT_ASCII;
+
+  FILE *f;
+  CHECK((f = fopen(output, "wb")) != NULL);
+  if(to == MNT_TILED)
+    mnt_write_tiled(m, f);
+  else if(to == MNT_BINARY)
+    mnt_write_binary(m, f);
+  else
+    mnt_write(m, f);
+  CHECK(fclose(f) == 0);
+
+  printf("%s: %d x %d, %s -> %s\n", output, m->nrows, m->ncols,
+         format_name(format), format_name(to));
+
+  mnt_free(m);
+  return(0);
+}
@@ -0,0 +1,62 @@
+// générateur de MNT synthétiques (voir src/generate.c) : même taille et même
+// graine donnent le même fichier, au format texte ou binaire.
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "type.h"
+#include "io.h"
+#include "generate.h"
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [-s <seed>] [-b] <rows> <cols> <output filename>\n",
+          prog);
+  fprintf(stderr, "  -s <seed>  random seed (default: 1)\n");
+  fprintf(stderr, "  -b         write the binary format instead of text\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long seed = 1;
+  int binary = 0, c;
+
+  while((c = getopt(argc, argv, "s:b")) != -1)
+  {
+    switch(c)
+    {
+      case 's':
+        seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        binary = 1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(argc - optind != 3)
+    usage(argv[0]);
+
+  const int nrows = atoi(argv[optind]), ncols = atoi(argv[optind + 1]);
+  if(nrows < 1 || ncols < 1)
+    usage(argv[0]);
+
+  mnt *m = mnt_generate(nrows, ncols, seed);
+
+  FILE *f;
+  CHECK((f = fopen(argv[optind + 2], "wb")) != NULL);
+  if(binary)
+    mnt_write_binary(m, f);
+  else
+    mnt_write(m, f);
+  CHECK(fclose(f) == 0);
+
+  printf("%s: %d x %d, seed %lu, %s\n", argv[optind + 2], nrows, ncols, seed,
+         binary ? "binary" : "text");
+
+  mnt_free(m);
+  return(0);
+}